@@ -3,15 +3,27 @@
 #include "StateTwoWire.h"
 #include "HardSPI.h"
 #include "Serial.h"
+#include "BufferedPrint.h"
 #include "bmp180.h"
 #include "hmc5883.h"
 #include "mpu60x0.h"
 #include "ad799x.h"
 #include "Time.h"
 #include "DirectTask.h"
+#include "Deferred.h"
+#include "Protothread.h"
 #include "LPC214x.h"
 #include "dump.h"
 #include "packet.h"
+#include "schema.h"
+#include "Downlink.h"
+#include "LoadShed.h"
+#include "PreTrigger.h"
+#include "Estimator.h"
+#include "Profile.h"
+#include "dtc.h"
+#include "irqstats.h"
+#include "hardware_stack.h"
 #include "sdhc.h"
 #include "Partition.h"
 #include "cluster.h"
@@ -36,8 +48,17 @@ volatile unsigned int drainTC0,drainTC1;
 
 const uint32_t fastReadPeriodMs=3;
 const uint32_t slowReadPeriodMs=10*fastReadPeriodMs;
+//Sensors are always read at the fast rate, so that the pre-trigger history has
+//full rate data in it. Until triggered, only one packet per slow period is logged.
+const uint32_t slowEvery=slowReadPeriodMs/fastReadPeriodMs;
 uint32_t readPeriodMs=fastReadPeriodMs; //Read period in ms
 
+//What counts as launch: the vertical detection, the acceleration magnitude going
+//over a threshold, or either one. The MPU6050 is set to +-16g full scale, which
+//is 2048 counts/g. Set triggerAccCounts to 0 to not use it.
+const bool triggerOnVert=true;
+const uint32_t triggerAccCounts=3*2048;
+
 inline uint32_t abs(int in) {
   return in>0?in:-in;
 }
@@ -53,12 +74,68 @@ BMP180 bmp180(Wire1);
 HMC5883 hmc5883(Wire1);
 MPU6050 mpu6050(Wire1,0);
 AD799x ad799x(Wire1);
-//const int dumpPktSize=120;
+//Serial output is queued and sent by the UART interrupt, so that the status
+//line printed from loop() doesn't hold up draining the packet store.
+char serialTxBuf[1024];
+Circular serialTx(sizeof(serialTxBuf),serialTxBuf);
+char serialRxBuf[64];
+Circular serialRx(sizeof(serialRxBuf),serialRxBuf);
 //Base85 d(Serial,dumpPktSize);
 //IntelHex d(Serial);
-FileCircular pktStore(f);
-CCSDS ccsds(pktStore);
-unsigned short pktseq[32];
+//The packet store is drained one block at a time, without waiting for the card
+//to finish programming, so this only has to hold what arrives while it does.
+char pktStoreBuf[SDHC::BLOCK_SIZE*8];
+FileCircular pktStore(f,sizeof(pktStoreBuf),pktStoreBuf);
+//When the card falls behind, average more samples into each packet rather than
+//lose whole samples when the store fills
+LoadShed shed(pktStore,0,SDHC::BLOCK_SIZE);
+//Full rate IMU samples from just before the trigger, logged as apid 0x18 once
+//it fires, with the same layout as 0x10.
+struct ImuSample {
+  uint32_t TC;
+  int16_t imu[7];
+  uint16_t hx[4];
+  uint32_t TC1;
+};
+const int preTriggerSamples=200; //0.6s at the fast rate
+ImuSample preTriggerBuf[preTriggerSamples];
+PreTrigger history(sizeof(ImuSample),preTriggerSamples,(char*)preTriggerBuf);
+//Attitude and altitude worked out on board, logged as apid 0x19 every estEvery
+//samples. The compass is assumed to have the same axes as the MPU6050.
+Estimator est;
+const uint32_t estEvery=10;
+//CCSDS indexes these by apid. The highest one in use is 0x1D, so there is no
+//need for all 2048 that 11 bits allow, and start() stops on any apid past the
+//end. A packet with named fields is held in the stash until its doc packets are
+//written, and the first packet of every apid goes through it, so it has to hold
+//the biggest packet, which is a block of the source dump.
+const int apidCount=0x20;
+unsigned short pktseq[apidCount];
+bool pktDocd[apidCount];
+char pktStash[SDHC::BLOCK_SIZE];
+CCSDS ccsds(pktStore,pktseq,pktDocd,pktStash,apidCount);
+//Where the time goes in the main loop, one region logged as apid 0x1A every
+//profEvery samples. The drain covers File::append and SDHC::write.
+const int profCollect=profiler.region("collectData");
+const int profMpu    =profiler.region("mpu6050");
+const int profAd     =profiler.region("ad799x");
+const int profHmc    =profiler.region("hmc5883");
+const int profFinish =profiler.region("ccsdsFinish");
+const int profDrain  =profiler.region("pktStoreDrain");
+const uint32_t profEvery=100;
+//Interrupt handler time and timer task lateness, logged as apid 0x1B every
+//irqStatsEvery samples, about once a second. Task 1 is the sample clock.
+const uint32_t irqStatsEvery=1000/fastReadPeriodMs;
+//Stack headroom and buffer high water marks, logged as apid 0x1C every
+//resEvery samples, about every 5 seconds
+const uint32_t resEvery=5000/fastReadPeriodMs;
+//Real-time telemetry over Serial1 to the radio, in parallel with the SD log
+const unsigned int downlinkBaud=9600;
+char downlinkTxBuf[1024];
+Circular downlinkTx(sizeof(downlinkTxBuf),downlinkTxBuf);
+char downlinkRxBuf[16];
+Circular downlinkRx(sizeof(downlinkRxBuf),downlinkRxBuf);
+Downlink downlink(Serial1,downlinkTx,0);
 
 const char syncMark[]="KwanSync";
 
@@ -69,16 +146,18 @@ void openLog(uint16_t inc=1) {
   Serial.println(log_i,DEC);
   if(inc==0) blinklock(108);
   static char fn[13];
-  if(fn[0]!='r') strcpy(fn,"rkto0000.sds");
+  //Find the highest numbered log already on the card in one pass over the
+  //directory, then skip to the next multiple of inc past it.
+  int highest;
+  if(!f.findHighest("rkto####.sds",highest)) blinklock(f.errno);
+  log_i=(highest<0)?0:(highest/inc+1)*inc;
+  if(log_i>9999) log_i=9999;
+  strcpy(fn,"rkto0000.sds");
+  fn[4]='0'+log_i/1000;
+  fn[5]='0'+(log_i%1000)/100;
+  fn[6]='0'+(log_i%100)/10;
+  fn[7]='0'+(log_i%10);
   Serial.println(fn);
-  while(log_i<9999 && f.find(fn)) {
-    log_i+=inc;
-    fn[4]='0'+log_i/1000;
-    fn[5]='0'+(log_i%1000)/100;
-    fn[6]='0'+(log_i%100)/10;
-    fn[7]='0'+(log_i%10);
-    Serial.println(fn);
-  }
   bool worked=f.openw(fn);
   Serial.print("f.openw(\"");Serial.print(fn);Serial.print("\"): ");Serial.print(worked?"Worked":"didn't work");Serial.print(". Status code ");Serial.println(f.errno);
   if(!worked) blinklock(f.errno);
@@ -89,6 +168,115 @@ void closeLog() {
                //object on a new file.
 }
 
+//The source tarball is logged once per card rather than once per boot. It goes
+//out as apid 0x03 a packet at a time, in between sensor packets, whenever the
+//store is nearly empty. Each packet is the primary header, a 32-bit offset, and
+//as much data as reaches the end of the SD block it starts in, so no part of
+//the dump is split across two blocks. Once all of it is on the card, a
+//marker file named for the hash of the tarball is written, and later boots of
+//the same build find it and skip the dump. Every log also gets an apid 0x1D
+//packet with the hash, so the log can be matched with the source.
+const uint32_t dumpHeaderSize=6+4;
+const uint32_t dumpMinData=64; ///< Less room than this left in the block, and the dump waits for the next one
+uint32_t sourceHash;
+uint32_t dumpPos;       ///< Offset of the next part of the tarball to log
+bool dumping;           ///< Tarball still needs to be logged
+bool srcMarkPending;    ///< Tarball all logged, marker to be written once the log is this long
+uint32_t srcMarkAtSize;
+bool writeSourceId;     ///< New log, needs an 0x1D packet and the packet dictionary
+bool writeDictPending;  ///< Packet dictionary not all logged yet
+PacketSchema::DictCursor dictCursor;
+char srcMarkName[13];
+File srcMark(fs);
+
+//32-bit FNV-1a, one multiply per byte
+static uint32_t hashSource() {
+  uint32_t h=2166136261U;
+  for(const char* p=source_start;p<source_end;p++) {
+    h^=(uint8_t)*p;
+    h*=16777619U;
+  }
+  return h;
+}
+
+static void beginSourceDump() {
+  static const char hexDigit[]="0123456789ABCDEF";
+  sourceHash=hashSource();
+  for(int i=0;i<8;i++) srcMarkName[i]=hexDigit[(sourceHash>>(28-4*i)) & 0x0F];
+  strcpy(srcMarkName+8,".SRC");
+  dumping=!srcMark.find(srcMarkName);
+  srcMark.errno=0;
+  dumpPos=0;
+  srcMarkPending=false;
+  writeSourceId=true;
+  Serial.print("Source ");Serial.print(srcMarkName);
+  Serial.println(dumping?" not on card, will be logged":" already on card");
+}
+
+static void writeSourceIdPacket(uint32_t TC) {
+  SourceIdPkt s={sourceHash,(uint32_t)(source_end-source_start),(uint8_t)(dumping?1:0),dumpPos};
+  ccsds.start(SourceIdPkt::apid,TC);
+  fill(ccsds,s);
+  ccsds.finish(SourceIdPkt::apid);
+  writeSourceId=false;
+}
+
+//The dictionary is over thirty doc packets, too much to put in the store at
+//once from the sample task, so it goes out one doc packet per sample. The
+//first log gets it all in setup(), before the sensors start.
+static void startDict() {
+  dictCursor.reset();
+  writeDictPending=true;
+}
+
+//\return true if a doc packet was written
+static bool writeDictNext() {
+  if(!writeDictPending) return false;
+  if(!PacketSchema::writeDictNext(ccsds,packetDict,packetDictLen,dictCursor)) return false;
+  writeDictPending=(dictCursor.i<packetDictLen);
+  return true;
+}
+
+//Where the next packet will be in the log file
+static uint32_t logPos() {
+  return f.size()+pktStore.readylen()+pktStore.unreadylen();
+}
+
+static void dumpSourcePacket() {
+  uint32_t room=SDHC::BLOCK_SIZE-logPos()%SDHC::BLOCK_SIZE;
+  //Other packets will soon take the log past this block
+  if(room<dumpHeaderSize+dumpMinData) return;
+  uint32_t len=source_end-source_start;
+  uint32_t n=len-dumpPos;
+  if(n>room-dumpHeaderSize) n=room-dumpHeaderSize;
+  ccsds.start(0x03);
+  ccsds.fillu32(dumpPos);
+  ccsds.fill(source_start+dumpPos,n);
+  ccsds.finish(0x03);
+  dumpPos+=n;
+  if(dumpPos>=len) {
+    //Everything in the store goes to the card in order, so once the log is
+    //this long, the last of the tarball is on the card
+    dumping=false;
+    srcMarkPending=true;
+    srcMarkAtSize=logPos();
+  }
+}
+
+//Failing to write the marker only means the next boot logs the source again
+static void writeSourceMark() {
+  srcMarkPending=false;
+  char block[SDHC::BLOCK_SIZE];
+  memset(block,0,sizeof(block));
+  strcpy(block,"Source tarball ");
+  strcat(block,srcMarkName);
+  strcat(block," logged as apid 0x03 on this card\r\n");
+  if(!srcMark.openw(srcMarkName) || !srcMark.append(block) || !srcMark.close()) {
+    Serial.print("Source marker not written: srcMark.errno=");
+    Serial.println(srcMark.errno);
+  }
+}
+
 static const char version_string[]="Rocketometer v1.1 using Kwan FAT/SD library " __DATE__ " " __TIME__;
 
 int16_t max,may,maz; //MPU60x0 acc
@@ -108,119 +296,303 @@ static void writeSdPacket() {
   ccsds.finish(0x11);
 }
 
+//Headroom is bytes never touched on each stack. High water is the most bytes
+//ever in each buffer at once, and the overflow count is times it filled up.
+//The layout is in schema.h, so the fields are documented once per log by the
+//dictionary rather than by doc packets from here.
+static void writeResourcePacket(uint32_t TC) {
+  ResourcePkt r;
+  r.irqStackFree=checkIRQStack();
+  r.fiqStackFree=checkFIQStack();
+  r.usrStackFree=checkUSRStack();
+  r.pktStoreSize=pktStore.size();
+  r.pktStoreHighWater=pktStore.getHighWater();
+  r.pktStoreOverflow=pktStore.getBufOverflow();
+  r.sdBufSize=sd.buf.size();
+  r.sdBufHighWater=sd.buf.getHighWater();
+  r.sdBufOverflow=sd.buf.getBufOverflow();
+  r.serialTxHighWater=serialTx.getHighWater();
+  r.serialTxOverflow=serialTx.getBufOverflow();
+  r.downlinkTxHighWater=downlinkTx.getHighWater();
+  r.downlinkTxOverflow=downlinkTx.getBufOverflow();
+  ccsds.start(ResourcePkt::apid,TC);
+  fill(ccsds,r);
+  ccsds.finish(ResourcePkt::apid);
+}
+
 static void maybeWriteSdPacket() {
   if(sd.buf.readylen()>128) writeSdPacket();
 }
 
 bool isVertNow;
-bool wasVert;
+bool wasVert; ///< Triggered, and logging at the full rate
 uint32_t vertTimeout;
 uint32_t oldOvr;
+uint32_t oldMaxWait;
+
+//Deferred queue priority for sample collection. This talks to sensors on Wire1,
+//as does the BMP180 protothread, so both must run from the main loop, never from
+//an interrupt.
+const int collectPriority=0;
 
 void collectData(void* stuff) {
   //Don't bother to read the sensors if we can't store the data
   //this way we yield more time back to the writing routine so 
   //hopefully the buffer becomes empty sooner
-  if(pktStore.isFull()) {
-    directTaskManager.reschedule(1,readPeriodMs,0,collectData,0); 
-    return; 
+  if(pktStore.isFull()) return; 
+  PROFILE(profCollect);
+  if(shed.update()) {
+    LoadShedPkt s={shed.getLevel(),shed.getReason(),shed.getFill(),shed.getWait(),pktStore.getBusySkips()};
+    ccsds.start(LoadShedPkt::apid,TTC(0));
+    fill(ccsds,s);
+    ccsds.finish(LoadShedPkt::apid);
   }
   if(oldOvr!=pktStore.getBufOverflow()) {
-    ccsds.start(0x15,pktseq,TC);
-    ccsds.fill(pktStore.getBufOverflow());
-    ccsds.finish(0x15);
+    OverflowPkt o={pktStore.getBufOverflow()};
+    ccsds.start(OverflowPkt::apid,TC);
+    fill(ccsds,o);
+    ccsds.finish(OverflowPkt::apid);
     oldOvr=pktStore.getBufOverflow();
   }
+  //Record each new worst case for how long a sample waited between the timer
+  //interrupt and the main loop getting around to it
+  if(oldMaxWait!=deferredQueue.getMaxWait(collectPriority)) {
+    oldMaxWait=deferredQueue.getMaxWait(collectPriority);
+    DeferredPkt d={oldMaxWait,deferredQueue.getMaxRun(collectPriority),
+                   deferredQueue.getCoalesced(collectPriority),deferredQueue.getOverflow(collectPriority)};
+    ccsds.start(DeferredPkt::apid,deferredQueue.postedTC());
+    fill(ccsds,d);
+    ccsds.finish(DeferredPkt::apid);
+  }
   static int phase=0;
   static uint32_t bmpTC;
+  static bool bmpPending=false;
   static char old_vbus=0;
   phase++;
   TC=TTC(0);
   vbus=gpio_read(23);
-  mpu6050.read(max,may,maz,mgx,mgy,mgz,mt);
+  {
+    PROFILE(profMpu);
+    mpu6050.read(max,may,maz,mgx,mgy,mgz,mt);
+  }
   isVertNow=(abs(maz)>abs(max)) && (abs(maz)>abs(may));
-  if(isVertNow) {
+  uint32_t accSq=(uint32_t)((int32_t)max*max)+(uint32_t)((int32_t)may*may)+(uint32_t)((int32_t)maz*maz);
+  bool isTrigNow=(triggerOnVert && isVertNow) || (triggerAccCounts>0 && accSq>triggerAccCounts*triggerAccCounts);
+  if(isTrigNow) {
     vertTimeout=uptime()+20*60;
     if(!wasVert) {
-      ccsds.start(0x14,pktseq,TC);
-      ccsds.fill((char)1);
-      ccsds.fill32((unsigned int)uptime());
-      ccsds.fill32((unsigned int)vertTimeout);
-      ccsds.finish(0x14);
+      //Keep what led up to this, and start logging it out behind the live data
+      history.freeze();
+      VertPkt v={1,(uint32_t)uptime(),vertTimeout};
+      ccsds.start(VertPkt::apid,TC);
+      fill(ccsds,v);
+      ccsds.finish(VertPkt::apid);
     }
     wasVert=true;
   } else if (wasVert) {
     wasVert=vertTimeout>uptime();
     if(!wasVert) {
-      ccsds.start(0x14,pktseq,TC);
-      ccsds.fill((char)0);
-      ccsds.fill32((unsigned int)uptime());
-      ccsds.fill32((unsigned int)vertTimeout);
-      ccsds.finish(0x14);
+      VertPkt v={0,(uint32_t)uptime(),vertTimeout};
+      ccsds.start(VertPkt::apid,TC);
+      fill(ccsds,v);
+      ccsds.finish(VertPkt::apid);
     }
   }
-  readPeriodMs=wasVert?fastReadPeriodMs:slowReadPeriodMs;
-  ad799x.read(hx);
+  {
+    PROFILE(profAd);
+    ad799x.read(hx);
+  }
   TC1=TTC(0);
-  ccsds.start(0x10,pktseq,TC);
-  ccsds.fill16(max);ccsds.fill16(may); ccsds.fill16(maz); ccsds.fill16(mgx); ccsds.fill16(mgy); ccsds.fill16(mgz); ccsds.fill16(mt);
-  ccsds.fill((char*)hx,8);
-  ccsds.fill32(TC1);
-  ccsds.finish(0x10);
+  ImuSample sample={TC,{max,may,maz,mgx,mgy,mgz,mt},{hx[0],hx[1],hx[2],hx[3]},TC1};
+  history.push(&sample);
+  //Run the estimator on every sample, and keep the worst case time it took
+  static uint32_t estMaxTicks=0;
+  uint32_t estTC0=TTC(0);
+  est.updateImu(mgx,mgy,mgz,max,may,maz,fastReadPeriodMs/1000.0f);
+  uint32_t estTC1=TTC(0);
+  uint32_t estTicks=dtc(estTC0,estTC1);
+  if(estTicks>estMaxTicks) estMaxTicks=estTicks;
+  static uint32_t estPhase=0;
+  estPhase++;
+  if(estPhase>=(estEvery<<shed.getLevel())) {
+    estPhase=0;
+    EstimatePkt e;
+    e.q[0]=(int16_t)(est.q0*32767);
+    e.q[1]=(int16_t)(est.q1*32767);
+    e.q[2]=(int16_t)(est.q2*32767);
+    e.q[3]=(int16_t)(est.q3*32767);
+    e.alt=(int32_t)(est.alt*100);
+    e.vz=(int32_t)(est.vz*100);
+    e.az=(int16_t)(est.az*100);
+    e.maxTicks=estMaxTicks;
+    ccsds.start(EstimatePkt::apid,TC);
+    fill(ccsds,e);
+    ccsds.finish(EstimatePkt::apid);
+    estMaxTicks=0;
+  }
+  //Average one slow period's worth of samples into each packet until triggered,
+  //and shed.decimation() times that many. The header time is that of the first
+  //sample averaged, and TC1 is from the last.
+  uint32_t group=(wasVert?1:slowEvery)<<shed.getLevel();
+  static int32_t imuSum[7];
+  static uint32_t hxSum[4];
+  static uint32_t imuN=0;
+  static uint32_t imuTC;
+  if(imuN==0) imuTC=TC;
+  for(int i=0;i<7;i++) imuSum[i]+=sample.imu[i];
+  for(int i=0;i<4;i++) hxSum[i]+=hx[i];
+  imuN++;
+  if(imuN>=group) {
+    ImuPkt avg;
+    for(int i=0;i<7;i++) {
+      avg.imu[i]=imuSum[i]/(int32_t)imuN;
+      imuSum[i]=0;
+    }
+    for(int i=0;i<4;i++) {
+      avg.hx[i]=hxSum[i]/imuN;
+      hxSum[i]=0;
+    }
+    avg.TC1=TC1;
+    ccsds.start(ImuPkt::apid,imuTC);
+    fill(ccsds,avg);
+    {
+      PROFILE(profFinish);
+      ccsds.finish(ImuPkt::apid);
+    }
+    imuN=0;
+  }
+  //Trickle the pre-trigger history out one sample at a time, as long as the
+  //store isn't backing up
+  ImuSample old;
+  if(history.isFrozen() && shed.getLevel()==0 && pktStore.freelen()>(int)pktStore.size()/2 && history.pop(&old)) {
+    HistoryPkt h;
+    memcpy(h.imu,old.imu,sizeof(h.imu));
+    memcpy(h.hx,old.hx,sizeof(h.hx));
+    h.TC1=old.TC1;
+    ccsds.start(HistoryPkt::apid,old.TC);
+    fill(ccsds,h);
+    ccsds.finish(HistoryPkt::apid);
+  }
+  if(history.isFrozen() && history.available()==0 && !wasVert) history.rearm();
+  if(writeSourceId) {
+    writeSourceIdPacket(TC);
+    startDict();
+  }
+  writeDictNext();
+  //Log the source only before launch, after the pre-trigger history, and only
+  //while the store is well below where load shedding would start
+  if(dumping && !wasVert && !history.isFrozen() && shed.getLevel()==0 && pktStore.freelen()>(int)(pktStore.size()*3/4)) {
+    dumpSourcePacket();
+  }
   if(vbus!=old_vbus) {
-    ccsds.start(0x13,pktseq,TC);
-    ccsds.fill(old_vbus);
-    ccsds.fill(vbus);
-    ccsds.finish(0x13);
+    VbusPkt v={(uint8_t)old_vbus,(uint8_t)vbus};
+    ccsds.start(VbusPkt::apid,TC);
+    fill(ccsds,v);
+    ccsds.finish(VbusPkt::apid);
     old_vbus=vbus;
   }
-  if(0==(phase%20)) {
-    //Only read the compass once every n times we read the 6DoF
+  static uint32_t compassPhase=0;
+  compassPhase++;
+  if(compassPhase>=((wasVert?20:20*slowEvery)<<shed.getLevel())) {
+    //Only read the compass once every n times we read the 6DoF, and less often when shedding load
+    compassPhase=0;
     TC=TTC(0);
-    hmc5883.read(bx,by,bz);
-    ccsds.start(0x04,pktseq,TC);
-    ccsds.fill16(bx);  ccsds.fill16(by);  ccsds.fill16(bz);
-    ccsds.finish(0x04);
+    {
+      PROFILE(profHmc);
+      hmc5883.read(bx,by,bz);
+    }
+    est.updateMag(bx,by,bz);
+    CompassPkt compass={bx,by,bz};
+    ccsds.start(CompassPkt::apid,TC);
+    fill(ccsds,compass);
+    ccsds.finish(CompassPkt::apid);
   }
-  if((500/readPeriodMs)==phase) {
-    //Only read the pressure sensor once every n times we read the 6DoF
+  if(!bmpPending && phase>=(int)((500U<<shed.getLevel())/readPeriodMs)) {
+    //Only read the pressure sensor once every n times we read the 6DoF. Since
+    //the read period and shed level can change between reads, don't wait for
+    //an exact phase which may already have gone by.
     bmpTC=TTC(0);  
     bmp180.startMeasurement();
+    bmpPending=true;
   } else if(bmp180.ready) {
     temperatureRaw=bmp180.getTemperatureRaw();
     pressureRaw=bmp180.getPressureRaw();
     temperature=bmp180.getTemperature();
     pressure=bmp180.getPressure();
+    est.updateBaro(pressure);
     bmp180.ready=false;
     TC1=TTC(0);
-    ccsds.start(0x0A,pktseq,bmpTC);
-    ccsds.fill16(temperatureRaw);
-    ccsds.fill32(pressureRaw);
-    ccsds.fill16(temperature);
-    ccsds.fill32(pressure);
-    ccsds.fill32(TC1);
-    ccsds.finish(0x0A);
+    BaroPkt baro={(uint16_t)temperatureRaw,(uint32_t)pressureRaw,temperature,pressure,TC1};
+    ccsds.start(BaroPkt::apid,bmpTC);
+    fill(ccsds,baro);
+    ccsds.finish(BaroPkt::apid);
     wantPrint=true;
+    bmpPending=false;
     phase=0;
   }
-  //Why here? Because since creation of packets is interrupt driven, and there
-  //is only a single buffer, only the interrupt routine is allowed to write
+  //Why here? Because there is only a single buffer, only one routine is
+  //allowed to write packets once the sensors are running
   if(writeDrain) {
-    ccsds.start(0x08,pktseq,drainTC0);
-    ccsds.fill32(drainTC1);
-    ccsds.finish(0x08);
+    DrainPkt d={drainTC1};
+    ccsds.start(DrainPkt::apid,drainTC0);
+    fill(ccsds,d);
+    ccsds.finish(DrainPkt::apid);
     writeDrain=false;
   }
   if(writeSd) {
     writeSdPacket();
     writeSd=false;
   }
-  directTaskManager.reschedule(1,readPeriodMs,0,collectData,0); 
+  static uint32_t profPhase=0;
+  profPhase++;
+  if(profPhase>=profEvery) {
+    profPhase=0;
+    profiler.write(ccsds,0x1A,TTC(0));
+  }
+  static uint32_t resPhase=0;
+  resPhase++;
+  if(resPhase>=resEvery) {
+    resPhase=0;
+    writeResourcePacket(TTC(0));
+  }
+#ifdef IRQ_STATS
+  static uint32_t irqStatsPhase=0;
+  irqStatsPhase++;
+  if(irqStatsPhase>=irqStatsEvery) {
+    irqStatsPhase=0;
+    static IrqStats::Table irqTable;
+    irqStats.snapshot(irqTable);
+    //Not in schema.h, since the length depends on how many sources fired
+    ccsds.start(0x1B,TTC(0));
+    ccsds.fillu32(irqTable.busyTicks);
+    ccsds.fillu32(irqTable.unknown);
+    for(int i=1;i<IrqStats::nChannels;i++) {
+      ccsds.fillu32(irqTable.late[i].count);
+      ccsds.fillu32(irqTable.late[i].maxTicks);
+      ccsds.fillu32(irqTable.late[i].sumTicks);
+    }
+    //Then only the sources which fired, each tagged with its VIC channel
+    for(int i=0;i<IrqStats::nSources;i++) if(irqTable.source[i].count>0) {
+      ccsds.fill((char)i);
+      ccsds.fillu32(irqTable.source[i].count);
+      ccsds.fillu32(irqTable.source[i].maxTicks);
+      ccsds.fillu32(irqTable.source[i].sumTicks);
+    }
+    ccsds.finish(0x1B);
+  }
+#endif
+}
+
+//Top half of the data collection, run in the timer interrupt. All it does is
+//keep the sample clock going and queue up the real work for the main loop.
+void collectDataTop(void* stuff) {
+  deferredQueue.post(collectPriority,collectData,stuff);
+  directTaskManager.reschedule(1,readPeriodMs,0,collectDataTop,0); 
 }
 
 void setup() {
   set_light(1,1);
-  Serial.begin(9600);
+  Serial.begin(9600,serialTx,serialRx);
   Serial.println(version_string);
   Wire1.begin();
 
@@ -247,30 +619,21 @@ void setup() {
   openLog(resetFileSkip);
   pktStore.fill(syncMark);
   pktStore.mark();
-  //Dump code to serial port and packet file
-  int len=source_end-source_start;
-  char* base=source_start;
-//  d.begin();
-  while(len>0) {
-//    d.line(base,0,len>dumpPktSize?dumpPktSize:len);
-    ccsds.start(0x03,pktseq);
-    ccsds.fill16(base-source_start);
-    ccsds.fill(base,len>dumpPktSize?dumpPktSize:len);
-    ccsds.finish(0x03);
-    pktStore.drain(); 
-    maybeWriteSdPacket();
-    base+=dumpPktSize;
-    len-=dumpPktSize;
-  }
-//  d.end();
+  //Code goes to the packet file in the background once the sensors are running
+  beginSourceDump();
+  writeSourceIdPacket(TTC(0));
+  startDict();
+  while(writeDictNext()) ;
 
-  ccsds.start(0x12,pktseq);
+  ccsds.start(0x12);
   sdinfo.fill(ccsds);
   ccsds.finish(0x12);
   pktStore.drain(); 
   maybeWriteSdPacket();
 
   mpu6050.begin(3,3);
+  //+-2000deg/s is 16.4 counts per deg/s, +-16g is 2048 counts per g
+  est.begin(3.14159265f/180.0f/16.4f,1.0f/2048.0f);
   Serial.print("MPU6050 identifier (should be 0x68): 0x");
   Serial.println(mpu6050.whoami(),HEX);
   ccsds.start(0x0F);
@@ -303,7 +666,9 @@ void setup() {
   pktStore.drain(); 
   maybeWriteSdPacket();
 
-  worked=bmp180.begin(2);
+  //No timer channel, measurement steps run as a protothread from loop()
+  worked=bmp180.begin(0);
+  protothreads.add(bmp180);
   Serial.print("bmp180");Serial.print(".begin ");Serial.print(worked?"Worked":"didn't work");Serial.print(". Status code ");Serial.println(0);
   Serial.print("BMP180 identifier (should be 0x55): 0x");
   Serial.println(bmp180.whoami(),HEX);
@@ -320,17 +685,17 @@ void setup() {
   maybeWriteSdPacket();
 
   ccsds.start(0x0C);
-  ccsds.fill32(HW_TYPE);
-  ccsds.fill32(HW_SERIAL);
+  ccsds.fillu32(HW_TYPE);
+  ccsds.fillu32(HW_SERIAL);
   ccsds.fill(MAMCR);
   ccsds.fill(MAMTIM);
-  ccsds.fill16(PLL0STAT);
+  ccsds.fillu16(PLL0STAT);
   ccsds.fill(VPBDIV);
-  ccsds.fill32(FOSC);                   //Crystal frequency, Hz
-  ccsds.fill32(CCLK);                   //Core Clock rate, Hz
-  ccsds.fill32(PCLK);                   //Peripheral Clock rate, Hz
-  ccsds.fill32(PREINT);  
-  ccsds.fill32(PREFRAC);                    
+  ccsds.fillu32(FOSC);                   //Crystal frequency, Hz
+  ccsds.fillu32(CCLK);                   //Core Clock rate, Hz
+  ccsds.fillu32(PCLK);                   //Peripheral Clock rate, Hz
+  ccsds.fillu32(PREINT);  
+  ccsds.fillu32(PREFRAC);                    
   ccsds.fill(CCR);
   ccsds.fill(version_string);
   ccsds.finish(0x0C);
@@ -342,24 +707,53 @@ void setup() {
   Serial.println("t,tc,bx,by,bz,max,may,maz,mgx,mgy,mgz,mt,h0,h1,h2,h3,T,P,vbus,ovr,wasVert,isVert");
 //  Serial.println("t,tc,Traw,Praw");
 
+  //Events and slow sensors every time, compass a couple of times a second, and
+  //the 6DoF sensor at about 10Hz when sampling fast. Priority 0 is highest.
+  Serial1.begin(downlinkBaud,downlinkTx,downlinkRx);
+  downlink.begin(downlinkBaud/10,256);
+  downlink.select(0x14,0);    //Vertical state change
+  downlink.select(0x15,0);    //Buffer overflow
+  downlink.select(0x17,0);    //Load shed level changes
+  downlink.select(0x18,3,33); //Pre-trigger history
+  downlink.select(0x19,1,10); //Estimated state
+  downlink.select(0x1A,3,10); //Profile
+  downlink.select(0x1B,2);    //Interrupt stats
+  downlink.select(0x1C,2);    //Stack and buffer use
+  downlink.select(0x1D,1);    //Source hash
+  downlink.select(0x0A,1);    //BMP180
+  downlink.select(0x16,1);    //Deferred queue worst case
+  downlink.select(0x04,2,10); //HMC5883
+  downlink.select(0x10,3,33); //MPU6050 and AD799x
+  ccsds.addSink(downlink);
+
   directTaskManager.begin();
-  directTaskManager.schedule(1,readPeriodMs,0,collectData,0); 
+  directTaskManager.schedule(1,readPeriodMs,0,collectDataTop,0); 
 }
 
 void loop() {
+  deferredQueue.runAll();
+  protothreads.runAll();
   drainTC0=TTC(0);  
-  if(pktStore.drain()) {
+  bool drained;
+  {
+    PROFILE(profDrain);
+    drained=pktStore.drain();
+  }
+  if(drained) {
+    shed.drained();
     flicker();
     writeDrain=true;
     drainTC1=TTC(0);
     if(sd.buf.readylen()>128) writeSd=true;
     uint32_t logSize;
     logSize=f.size();
+    if(srcMarkPending && logSize>=srcMarkAtSize) writeSourceMark();
     if(logSize>=maxLogSize) {
       closeLog();
       openLog();
       pktStore.fill(syncMark);
       pktStore.mark();
+      writeSourceId=true;
     }
   }
   if(pktStore.errno!=0) {
@@ -368,33 +762,35 @@ void loop() {
     blinklock(pktStore.errno);
   }
   if(wantPrint) {
-    Serial.print(RTCHOUR,DEC,2);
-    Serial.print(":");Serial.print(RTCMIN,DEC,2);
-    Serial.print(":");Serial.print(((unsigned int)(TC/PCLK)),DEC,2);
-    Serial.print(".");Serial.print(((unsigned int)((TC%PCLK)/(PCLK/1000))),DEC,3);
-    Serial.print(",");Serial.print(((unsigned int)(TC)),DEC,10);
-    Serial.print(",");Serial.print(bx, DEC); 
-    Serial.print(",");Serial.print(by, DEC); 
-    Serial.print(",");Serial.print(bz, DEC); 
-    Serial.print(",");Serial.print(max, DEC);
-    Serial.print(",");Serial.print(may, DEC);
-    Serial.print(",");Serial.print(maz, DEC);
-    Serial.print(",");Serial.print(mgx, DEC);
-    Serial.print(",");Serial.print(mgy, DEC);
-    Serial.print(",");Serial.print(mgz, DEC);
-    Serial.print(",");Serial.print(mt, DEC);
-    Serial.print(",");Serial.print(hx[0], HEX,4); 
-    Serial.print(",");Serial.print(hx[1], HEX,4); 
-    Serial.print(",");Serial.print(hx[2], HEX,4); 
-    Serial.print(",");Serial.print(hx[3], HEX,4); 
-    Serial.print(",");Serial.print(temperature/10, DEC);    
-    Serial.print(".");Serial.print(temperature%10, DEC);    
-    Serial.print(",");Serial.print((unsigned int)pressure, DEC); 
-    Serial.print(",");Serial.print(vbus, DEC); 
-    Serial.print(",");Serial.print((unsigned int)pktStore.getBufOverflow(), DEC); 
-    Serial.print(",");Serial.print(wasVert?1:0, DEC); 
-    Serial.print(",");Serial.print(isVertNow?1:0, DEC); 
-    Serial.println();
+    //Build the line on the stack and hand it to the port in one piece
+    BufferedPrint<128> line(Serial);
+    line.print(RTCHOUR,DEC,2);
+    line.print(":");line.print(RTCMIN,DEC,2);
+    line.print(":");line.print(((unsigned int)(TC/PCLK)),DEC,2);
+    line.print(".");line.print(((unsigned int)((TC%PCLK)/(PCLK/1000))),DEC,3);
+    line.print(",");line.print(((unsigned int)(TC)),DEC,10);
+    line.print(",");line.print(bx, DEC); 
+    line.print(",");line.print(by, DEC); 
+    line.print(",");line.print(bz, DEC); 
+    line.print(",");line.print(max, DEC);
+    line.print(",");line.print(may, DEC);
+    line.print(",");line.print(maz, DEC);
+    line.print(",");line.print(mgx, DEC);
+    line.print(",");line.print(mgy, DEC);
+    line.print(",");line.print(mgz, DEC);
+    line.print(",");line.print(mt, DEC);
+    line.print(",");line.print(hx[0], HEX,4); 
+    line.print(",");line.print(hx[1], HEX,4); 
+    line.print(",");line.print(hx[2], HEX,4); 
+    line.print(",");line.print(hx[3], HEX,4); 
+    line.print(",");line.print(temperature/10, DEC);    
+    line.print(".");line.print(temperature%10, DEC);    
+    line.print(",");line.print((unsigned int)pressure, DEC); 
+    line.print(",");line.print(vbus, DEC); 
+    line.print(",");line.print((unsigned int)pktStore.getBufOverflow(), DEC); 
+    line.print(",");line.print(wasVert?1:0, DEC); 
+    line.print(",");line.print(isVertNow?1:0, DEC); 
+    line.println();
     wantPrint=false;
   }
 }
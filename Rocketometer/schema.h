@@ -0,0 +1,96 @@
+#ifndef schema_h
+#define schema_h
+
+#include "packetSchema.h"
+
+//Layouts of the fixed-size packets, logged as doc packets at the start of
+//every log. A host decoder can include this to parse them directly. The
+//pre-trigger history (0x18) has the same layout as the live IMU packets (0x10).
+//Not here are the packets whose length varies (the source dump 0x03, SD
+//status 0x11, profile 0x1A, which names its own fields, and interrupt stats
+//0x1B), and the sensor and hardware descriptions written once from setup()
+//with no timestamp (0x02, 0x0C-0x0F, 0x12).
+#define ROCKETOMETER_IMU_FIELDS(FLD,ARR) \
+    ARR(i16,imu,7) /*max,may,maz,mgx,mgy,mgz,mt*/ \
+    ARR(u16,hx,4)  /*AD799x channels*/ \
+    FLD(u32,TC1)   /*Timer count after the last sample was read*/
+
+#define ROCKETOMETER_PACKETS(PKT,FLD,ARR,END) \
+  PKT(0x04,CompassPkt) \
+    FLD(i16,bx) \
+    FLD(i16,by) \
+    FLD(i16,bz) \
+  END() \
+  PKT(0x08,DrainPkt) /*Each drain of the packet store that wrote to the card, timestamped when it started*/ \
+    FLD(u32,drainTC1)  /*Timer count when it finished*/ \
+  END() \
+  PKT(0x0A,BaroPkt) \
+    FLD(u16,temperatureRaw) \
+    FLD(u32,pressureRaw) \
+    FLD(i16,temperature) /*0.1 degC*/ \
+    FLD(i32,pressure)    /*Pa*/ \
+    FLD(u32,TC1)         /*Timer count when the measurement finished*/ \
+  END() \
+  PKT(0x10,ImuPkt) \
+    ROCKETOMETER_IMU_FIELDS(FLD,ARR) \
+  END() \
+  PKT(0x13,VbusPkt) /*Each change of USB power*/ \
+    FLD(u8,oldVbus) \
+    FLD(u8,vbus) \
+  END() \
+  PKT(0x14,VertPkt) /*Trigger, and the end of the logging it started*/ \
+    FLD(u8,vert)       /*1 when triggered, 0 when the timeout runs out*/ \
+    FLD(u32,uptime)    /*Seconds since boot*/ \
+    FLD(u32,timeout)   /*Uptime at which full rate logging stops*/ \
+  END() \
+  PKT(0x15,OverflowPkt) /*Each time the packet store fills up*/ \
+    FLD(u32,bufOverflow) /*Times it has filled up*/ \
+  END() \
+  PKT(0x16,DeferredPkt) /*Each new worst case wait of the sample task*/ \
+    FLD(u32,maxWait)   /*Ticks from the timer interrupt to the main loop running it*/ \
+    FLD(u32,maxRun)    /*Ticks it took to run*/ \
+    FLD(u32,coalesced) /*Posts merged with one already waiting*/ \
+    FLD(u32,overflow)  /*Posts dropped with the queue full*/ \
+  END() \
+  PKT(0x17,LoadShedPkt) /*Each change of shed level*/ \
+    FLD(u8,level)      /*Data rate is cut by 2^level*/ \
+    FLD(u8,reason)     /*1 if the store filled up, 2 if it waited too long for a drain*/ \
+    FLD(u8,fill)       /*Percent of the packet store in use*/ \
+    FLD(u32,wait)      /*Ticks the data has waited for a drain*/ \
+    FLD(u32,busySkips) /*Drains which found the card still busy*/ \
+  END() \
+  PKT(0x18,HistoryPkt) \
+    ROCKETOMETER_IMU_FIELDS(FLD,ARR) \
+  END() \
+  PKT(0x19,EstimatePkt) /*Attitude and altitude worked out on board*/ \
+    ARR(i16,q,4)        /*Attitude quaternion q0..q3, Q15*/ \
+    FLD(i32,alt)        /*cm*/ \
+    FLD(i32,vz)         /*cm/s*/ \
+    FLD(i16,az)         /*cm/s^2*/ \
+    FLD(u32,maxTicks)   /*Longest the estimator took on one sample since the last packet*/ \
+  END() \
+  PKT(0x1C,ResourcePkt) \
+    FLD(i32,irqStackFree) /*Bytes never touched on each stack*/ \
+    FLD(i32,fiqStackFree) \
+    FLD(i32,usrStackFree) \
+    FLD(u32,pktStoreSize) /*Then for each buffer, the size or most ever in it, and times it filled up*/ \
+    FLD(u32,pktStoreHighWater) \
+    FLD(u32,pktStoreOverflow) \
+    FLD(u32,sdBufSize) \
+    FLD(u32,sdBufHighWater) \
+    FLD(u32,sdBufOverflow) \
+    FLD(u32,serialTxHighWater) \
+    FLD(u32,serialTxOverflow) \
+    FLD(u32,downlinkTxHighWater) \
+    FLD(u32,downlinkTxOverflow) \
+  END() \
+  PKT(0x1D,SourceIdPkt) /*Once per log, the build the source dump (apid 0x03) belongs to*/ \
+    FLD(u32,hash)       /*FNV-1a of the source tarball*/ \
+    FLD(u32,len)        /*Length of the tarball*/ \
+    FLD(u8,dumping)     /*1 if the tarball is still being logged on this card*/ \
+    FLD(u32,dumpPos)    /*Offset of the next part of it to log*/ \
+  END()
+
+PACKET_SCHEMA_DEFINE(ROCKETOMETER_PACKETS)
+
+#endif
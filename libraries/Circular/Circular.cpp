@@ -9,6 +9,7 @@ bool Circular::fill(char in) {
     return true;
   }
   //if buffer is full, throw away all unmarked data
+  highWater=N-1;
   head=mid;
   if(!fullState) bufOverflow++; //wasn't full when we got here, count this as an overflow
   fullState=true;
@@ -87,6 +88,19 @@ int Circular::readylen() {
   return m-t;
 }
 
+void Circular::unreadySpans(const char*& a, uint32_t& alen, const char*& b, uint32_t& blen) {
+  uint32_t h=head;
+  a=buf+mid;
+  b=buf;
+  if(h>=mid) {
+    alen=h-mid;
+    blen=0;
+  } else {
+    alen=N-mid;
+    blen=h;
+  }
+}
+
 bool Circular::drain(Circular& to) {
   while(readylen()>0) {
     if(to.isFull()) {
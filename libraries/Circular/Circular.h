@@ -26,8 +26,18 @@ protected:
   //no new data should be accepted until buffer is drained.
   bool fullState;
   uint32_t bufOverflow;
+  //Most characters ever in the buffer at once, ready or not
+  uint32_t highWater;
+  //Only needs to be checked when data is marked, since the buffer only fills
+  //between marks, and when it overflows
+  void noteHighWater() {
+    uint32_t h=head;
+    uint32_t t=tail;
+    uint32_t used=(h>=t)?h-t:h+N-t;
+    if(used>highWater) highWater=used;
+  };
 public:
-  Circular(uint32_t LN, char* Lbuf):N(LN),buf(Lbuf),head(0),mid(0),tail(0),fullState(false),bufOverflow(0) {}
+  Circular(uint32_t LN, char* Lbuf):N(LN),buf(Lbuf),head(0),mid(0),tail(0),fullState(false),bufOverflow(0),highWater(0) {}
   //Is there no space to write another char?  
   bool isFull() {return fullState || ((head+1)%N==tail);};
   //Is there at least one char ready to be read?
@@ -57,7 +67,7 @@ public:
   bool fill32LE(uint32_t in) {return fill((char*)&in,4);};
 
   //Mark all current unready data as ready
-  virtual void mark() {mid=head;};
+  virtual void mark() {mid=head;noteHighWater();};
 
 
   //Get the next character ready to be flushed
@@ -72,6 +82,12 @@ public:
   int unreadylen();
   //Get the number of characters which are ready
   int readylen();
+  //Get the number of characters which may still be written before the buffer is full
+  int freelen() {return N-1-unreadylen()-readylen();};
+  uint32_t size() {return N;};
+  //Get the data which isn't ready yet as two contiguous pieces, the second of
+  //which is empty unless the data wraps around the end of the buffer.
+  void unreadySpans(const char*& a, uint32_t& alen, const char*& b, uint32_t& blen);
 
   char peekTail(int ahead=0);
   char peekMid(int ahead=0);
@@ -85,6 +101,7 @@ public:
   char* volatile tailPtr() {return buf+tail;}
   char* volatile midPtr()  {return buf+mid;}
   uint32_t getBufOverflow() {return bufOverflow;}
+  uint32_t getHighWater() {return highWater;}
 };
 
 #endif
@@ -0,0 +1,69 @@
+#include "Downlink.h"
+#include "Time.h"
+#include "LPC214x.h"
+#include "dtc.h"
+
+Downlink::Downlink(Print& Louf, Circular& Lq, int Ltimer):ouf(Louf),q(Lq),timer(Ltimer),
+  ticksPerByte(0),creditMax(0),credit(0),lastTC(0),offered(0),decimated(0),dropped(0),sent(0),bytesSent(0) {
+  for(int i=0;i<DOWNLINK_APIDS;i++) {
+    policy[i].priority=never;
+    policy[i].decimation=1;
+    policy[i].count=0;
+  }
+}
+
+void Downlink::begin(uint32_t bytesPerSec, uint32_t burst) {
+  ticksPerByte=Time::PCLK/bytesPerSec;
+  creditMax=burst*ticksPerByte;
+  credit=creditMax;
+  lastTC=TTC(timer);
+}
+
+bool Downlink::select(uint16_t apid, uint8_t priority, uint8_t decimation) {
+  if(apid>=DOWNLINK_APIDS) return false;
+  if(priority>=levels) priority=levels-1;
+  policy[apid].priority=priority;
+  policy[apid].decimation=decimation>0?decimation:1;
+  policy[apid].count=0;
+  return true;
+}
+
+//Add the link time that has gone by since last time
+void Downlink::refill() {
+  uint32_t tc=TTC(timer);
+  uint32_t elapsed=dtc(lastTC,tc,timer);
+  lastTC=tc;
+  if(elapsed>=creditMax-credit) {
+    credit=creditMax;
+  } else {
+    credit+=elapsed;
+  }
+}
+
+void Downlink::offer(uint16_t apid, const char* a, uint32_t alen, const char* b, uint32_t blen) {
+  if(apid>=DOWNLINK_APIDS) return;
+  Policy& p=policy[apid];
+  if(p.priority==never) return;
+  offered++;
+  p.count++;
+  if(p.count<p.decimation) {
+    decimated++;
+    return;
+  }
+  p.count=0;
+  refill();
+  uint32_t len=alen+blen;
+  uint32_t cost=len*ticksPerByte;
+  uint32_t creditReserve=(creditMax/levels)*p.priority;
+  uint32_t queueReserve=(q.size()/levels)*p.priority;
+  uint32_t free=q.freelen();
+  if(cost>credit || credit-cost<creditReserve || len>free || free-len<queueReserve) {
+    dropped++;
+    return;
+  }
+  credit-=cost;
+  ouf.write(a,alen);
+  if(blen>0) ouf.write(b,blen);
+  sent++;
+  bytesSent+=len;
+}
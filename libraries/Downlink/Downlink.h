@@ -0,0 +1,91 @@
+#ifndef DOWNLINK_H
+#define DOWNLINK_H
+
+#include <inttypes.h>
+#include "packet.h"
+
+/* Real-time telemetry downlink. Hook one of these to the packet producer with
+CCSDS::addSink() and it will be offered every packet as it is finished. Packets
+from selected apids are copied, whole, into the transmit queue of a serial port
+in buffered mode, typically Serial1 feeding a radio. Everything else is ignored
+without being copied.
+
+A radio link can carry much less than the packet producer makes, so three
+things decide whether a selected packet is sent:
+
+Decimation - only one of every n packets of a given apid is considered.
+
+Link budget - the link is given a byte rate, and a credit of timer ticks builds
+up at that rate, up to a limit of a few packets' worth of burst. Sending a packet
+spends the credit for its length, so on average the link is never asked for
+more than its rate.
+
+Priority - 0 is highest. A packet at priority p is only sent if it leaves p
+quarters of the maximum credit and of the transmit queue unused, so that lower
+priority packets can never crowd out higher ones.
+
+A packet which can't be sent is dropped, never delayed. Either the whole packet
+goes into the queue or none of it does, so the stream on the link is always
+whole packets.
+
+Apids at or above DOWNLINK_APIDS can't be selected. It may be changed in the
+program Makefile like this:
+
+CDEFS += -DDOWNLINK_APIDS=64
+*/
+#ifndef DOWNLINK_APIDS
+#define DOWNLINK_APIDS 32
+#endif
+
+class Downlink: public PacketSink {
+private:
+  struct Policy {
+    uint8_t priority;   ///< 0 is highest, never if not selected
+    uint8_t decimation; ///< Send one out of every this many
+    uint8_t count;      ///< Packets seen since the last one considered
+  };
+  Policy policy[DOWNLINK_APIDS];
+  Print& ouf;
+  Circular& q;
+  int timer;
+  uint32_t ticksPerByte;
+  uint32_t creditMax;
+  uint32_t credit;      ///< Ticks of link time available right now
+  uint32_t lastTC;
+  uint32_t offered;     ///< Selected packets seen
+  uint32_t decimated;   ///< Selected packets skipped by decimation
+  uint32_t dropped;     ///< Selected packets skipped for lack of link budget or queue space
+  uint32_t sent;        ///< Packets put in the transmit queue
+  uint32_t bytesSent;   ///< Bytes put in the transmit queue
+  void refill();
+public:
+  static const uint8_t levels=4;
+  static const uint8_t never=0xFF;
+  /**
+  \param Louf  Port to send packets out of. Should be in buffered mode, with Lq as its transmit queue
+  \param Lq    Transmit queue of the port, used to check that a whole packet will fit without waiting
+  \param Ltimer Timer used to measure time for the link budget
+  */
+  Downlink(Print& Louf, Circular& Lq, int Ltimer);
+  /**Set the link budget
+  \param bytesPerSec Rate that the link can carry, for instance baud/10 for 8N1
+  \param burst       Most bytes which may be sent at once after the link has been idle
+  */
+  void begin(uint32_t bytesPerSec, uint32_t burst);
+  /**Select an apid to be sent
+  \param apid       apid to send
+  \param priority   0 is highest, up to levels-1
+  \param decimation Send only one of every this many packets of this apid
+  \return true if the apid was selected, false if it is out of range
+  */
+  bool select(uint16_t apid, uint8_t priority, uint8_t decimation=1);
+  void deselect(uint16_t apid) {if(apid<DOWNLINK_APIDS) policy[apid].priority=never;};
+  void offer(uint16_t apid, const char* a, uint32_t alen, const char* b, uint32_t blen) override;
+  uint32_t getOffered()   {return offered;};
+  uint32_t getDecimated() {return decimated;};
+  uint32_t getDropped()   {return dropped;};
+  uint32_t getSent()      {return sent;};
+  uint32_t getBytesSent() {return bytesSent;};
+};
+
+#endif
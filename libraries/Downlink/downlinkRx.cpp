@@ -0,0 +1,144 @@
+/* Host side receiver for the telemetry downlink. Reads the binary CCSDS stream
+from a serial port (or a file, or stdin), finds packet boundaries, and
+periodically reports what arrived and how much of the link it used.
+
+Usage: downlinkRx <port|file|-> <baud> [reportSeconds]
+
+The stream may start in the middle of a packet, and bytes may be lost on the
+link, so a header is only believed if it looks like one of ours (version 0,
+telemetry, not grouped, reasonable length) and the header right after it does
+too. Bytes which aren't part of a believed packet are counted as skipped.
+
+Sequence numbers are per apid, and count every packet made, not just the ones
+sent down the link, so a sequence jump counts packets which were decimated or
+dropped on the spacecraft side as well as any lost on the link.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+#include "packetScan.h"
+
+static const int nApids=2048;
+
+struct ApidStats {
+  uint32_t packets;
+  uint32_t bytes;
+  uint32_t seqSkipped;
+  int lastSeq;
+};
+
+static ApidStats stats[nApids];
+static uint64_t totalBytes,packetBytes,skippedBytes;
+static uint32_t totalPackets;
+
+static speed_t baudConst(int baud) {
+  switch(baud) {
+    case 1200:   return B1200;
+    case 2400:   return B2400;
+    case 4800:   return B4800;
+    case 9600:   return B9600;
+    case 19200:  return B19200;
+    case 38400:  return B38400;
+    case 57600:  return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+  }
+  return B0;
+}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+static void count(const uint8_t* p, int len) {
+  int apid=((p[0]<<8) | p[1]) & 0x7FF;
+  int seq =((p[2]<<8) | p[3]) & 0x3FFF;
+  ApidStats& s=stats[apid];
+  if(s.packets>0) s.seqSkipped+=(seq-s.lastSeq-1) & 0x3FFF;
+  s.lastSeq=seq;
+  s.packets++;
+  s.bytes+=len;
+  totalPackets++;
+  packetBytes+=len;
+}
+
+static void report(double elapsed, int baud) {
+  double capacity=elapsed*baud/10.0;
+  fprintf(stderr,"--- %.1fs: %u packets, %llu packet bytes, %llu skipped bytes, %llu total bytes\n",
+          elapsed,totalPackets,(unsigned long long)packetBytes,(unsigned long long)skippedBytes,(unsigned long long)totalBytes);
+  if(capacity>0) {
+    fprintf(stderr,"    link utilization %.1f%% (%.1f%% in whole packets) of %d baud\n",
+            100.0*totalBytes/capacity,100.0*packetBytes/capacity,baud);
+  }
+  fprintf(stderr,"    apid  packets    bytes  seqSkipped  share\n");
+  for(int i=0;i<nApids;i++) {
+    ApidStats& s=stats[i];
+    if(s.packets==0) continue;
+    fprintf(stderr,"    0x%03x %8u %8u  %10u  %5.1f%%\n",i,s.packets,s.bytes,s.seqSkipped,
+            packetBytes>0?100.0*s.bytes/packetBytes:0.0);
+  }
+}
+
+int main(int argc, char** argv) {
+  if(argc<3) {
+    fprintf(stderr,"Usage: %s <port|file|-> <baud> [reportSeconds]\n",argv[0]);
+    return 1;
+  }
+  int baud=atoi(argv[2]);
+  double reportPeriod=argc>3?atof(argv[3]):5.0;
+  int fd=0;
+  if(strcmp(argv[1],"-")!=0) {
+    fd=open(argv[1],O_RDONLY | O_NOCTTY);
+    if(fd<0) {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+  if(isatty(fd)) {
+    struct termios tio;
+    tcgetattr(fd,&tio);
+    cfmakeraw(&tio);
+    speed_t speed=baudConst(baud);
+    if(speed==B0) {
+      fprintf(stderr,"Unsupported baud rate %d\n",baud);
+      return 1;
+    }
+    cfsetispeed(&tio,speed);
+    cfsetospeed(&tio,speed);
+    tcsetattr(fd,TCSANOW,&tio);
+  }
+  //Holds at least two packets, so that we can check the header after the one we are looking at
+  static uint8_t buf[maxPacket*2+6];
+  int have=0;
+  double t0=0,lastReport=0;
+  bool eof=false;
+  while(!eof || have>0) {
+    if(!eof) {
+      int got=read(fd,buf+have,sizeof(buf)-have);
+      if(got<=0) {
+        eof=true;
+      } else {
+        if(totalBytes==0) t0=lastReport=now();
+        totalBytes+=got;
+        have+=got;
+      }
+    }
+    //Use up as many whole packets as we can
+    int pos=scanPackets(buf,have,eof,count,&skippedBytes);
+    memmove(buf,buf+pos,have-pos);
+    have-=pos;
+    if(totalBytes>0 && now()-lastReport>=reportPeriod) {
+      lastReport=now();
+      report(lastReport-t0,baud);
+    }
+  }
+  report(now()-t0,baud);
+  return 0;
+}
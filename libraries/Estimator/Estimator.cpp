@@ -0,0 +1,123 @@
+#include <string.h>
+#include "Estimator.h"
+
+static const fp g=9.80665f;
+
+//Standard atmosphere altitude in m as a polynomial in (p/p0-1), good to 2cm
+//for p/p0 from 0.4 to 1.1, so that we don't need a pow() function.
+static const fp altPoly[]={-0.013803695f,-8435.6758f,3422.4757f,-2049.1654f,936.15326f,-4415.4066f,-6940.4264f,-7725.8072f};
+static const int altOrder=sizeof(altPoly)/sizeof(altPoly[0])-1;
+
+Estimator::Estimator():gyroScale(0),accScale(0),kp(0),ki(0),ix(0),iy(0),iz(0),mx(0),my(0),mz(0),haveMag(false),p0(0),
+  q0(1),q1(0),q2(0),q3(0),alt(0),vz(0),az(0),baroAlt(0),alpha(0.2f),beta(0.05f) {
+}
+
+void Estimator::begin(fp LgyroScale, fp LaccScale, fp Lkp, fp Lki) {
+  gyroScale=LgyroScale;
+  accScale=LaccScale;
+  kp=Lkp;
+  ki=Lki;
+}
+
+//Fast approximate 1/sqrt(x), with two Newton steps, good to about 5 parts in 10^6
+fp Estimator::invSqrt(fp x) {
+  uint32_t i;
+  fp y=x;
+  memcpy(&i,&y,sizeof(i));
+  i=0x5F3759DF-(i>>1);
+  memcpy(&y,&i,sizeof(y));
+  y=y*(1.5f-0.5f*x*y*y);
+  y=y*(1.5f-0.5f*x*y*y);
+  return y;
+}
+
+fp Estimator::altitude(fp pressure, fp p0) {
+  return poly(pressure/p0-1.0f,altPoly,altOrder);
+}
+
+void Estimator::updateMag(int16_t bx, int16_t by, int16_t bz) {
+  fp n=(fp)bx*bx+(fp)by*by+(fp)bz*bz;
+  if(n==0) return;
+  n=invSqrt(n);
+  mx=bx*n;
+  my=by*n;
+  mz=bz*n;
+  haveMag=true;
+}
+
+void Estimator::updateImu(int16_t Lgx, int16_t Lgy, int16_t Lgz, int16_t Lax, int16_t Lay, int16_t Laz, fp dt) {
+  fp gx=Lgx*gyroScale;
+  fp gy=Lgy*gyroScale;
+  fp gz=Lgz*gyroScale;
+  fp ax=Lax*accScale;
+  fp ay=Lay*accScale;
+  fp az1=Laz*accScale;
+  fp q0q0=q0*q0, q0q1=q0*q1, q0q2=q0*q2, q0q3=q0*q3;
+  fp q1q1=q1*q1, q1q2=q1*q2, q1q3=q1*q3;
+  fp q2q2=q2*q2, q2q3=q2*q3;
+  fp q3q3=q3*q3;
+  //Direction of up in the body frame, half size
+  fp vx=q1q3-q0q2;
+  fp vy=q0q1+q2q3;
+  fp vz1=q0q0-0.5f+q3q3;
+  //Vertical acceleration, before the attitude moves on
+  az=(2.0f*(vx*ax+vy*ay+vz1*az1)-1.0f)*g;
+  fp an=ax*ax+ay*ay+az1*az1;
+  fp ex=0,ey=0,ez=0;
+  if(an>0.5625f && an<1.5625f) {
+    //Within 25% of 1g, so mostly gravity
+    an=invSqrt(an);
+    ax*=an;ay*=an;az1*=an;
+    ex=ay*vz1-az1*vy;
+    ey=az1*vx-ax*vz1;
+    ez=ax*vy-ay*vx;
+    if(haveMag) {
+      //Direction of the field in the earth frame, turned so it has no east part
+      fp hx=2.0f*(mx*(0.5f-q2q2-q3q3)+my*(q1q2-q0q3)+mz*(q1q3+q0q2));
+      fp hy=2.0f*(mx*(q1q2+q0q3)+my*(0.5f-q1q1-q3q3)+mz*(q2q3-q0q1));
+      fp bz=2.0f*(mx*(q1q3-q0q2)+my*(q2q3+q0q1)+mz*(0.5f-q1q1-q2q2));
+      fp bx=hx*hx+hy*hy;
+      bx=bx*invSqrt(bx);
+      //Direction of the field in the body frame, half size
+      fp wx=bx*(0.5f-q2q2-q3q3)+bz*(q1q3-q0q2);
+      fp wy=bx*(q1q2-q0q3)+bz*(q0q1+q2q3);
+      fp wz=bx*(q0q2+q1q3)+bz*(0.5f-q1q1-q2q2);
+      ex+=my*wz-mz*wy;
+      ey+=mz*wx-mx*wz;
+      ez+=mx*wy-my*wx;
+    }
+    if(ki>0) {
+      ix+=2.0f*ki*ex*dt;
+      iy+=2.0f*ki*ey*dt;
+      iz+=2.0f*ki*ez*dt;
+    }
+  }
+  gx+=ix+2.0f*kp*ex;
+  gy+=iy+2.0f*kp*ey;
+  gz+=iz+2.0f*kp*ez;
+  gx*=0.5f*dt;
+  gy*=0.5f*dt;
+  gz*=0.5f*dt;
+  fp a=q0,b=q1,c=q2;
+  q0+=-b*gx-c*gy-q3*gz;
+  q1+= a*gx+c*gz-q3*gy;
+  q2+= a*gy-b*gz+q3*gx;
+  q3+= a*gz+b*gy-c*gx;
+  fp n=invSqrt(q0*q0+q1*q1+q2*q2+q3*q3);
+  q0*=n;q1*=n;q2*=n;q3*=n;
+  vz+=az*dt;
+  alt+=vz*dt;
+}
+
+void Estimator::updateBaro(int32_t pressure) {
+  if(pressure<=0) return;
+  if(p0==0) {
+    p0=pressure;
+    alt=0;
+    vz=0;
+  }
+  baroAlt=altitude(pressure,p0);
+  fp r=baroAlt-alt;
+  alt+=alpha*r;
+  vz+=beta*r;
+}
@@ -0,0 +1,58 @@
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include <inttypes.h>
+#include "float.h"
+
+/* Onboard state estimator. Attitude is a quaternion, kept up by integrating
+the gyro, and pulled towards the attitude implied by the accelerometer (for
+down) and compass (for north) by a proportional-integral correction, after
+Mahony. The accelerometer is only believed when it reads close to 1g, so that
+thrust and drag don't tilt the estimate during powered flight.
+
+Altitude and vertical velocity are integrated from the vertical component of
+acceleration at the IMU rate, then corrected by barometric altitude whenever a
+pressure reading comes in, with fixed alpha-beta gains.
+
+Nothing in here touches the hardware, so the same code runs on the host to
+replay recorded logs. Sensor readings are raw counts, scaled by the factors
+given to begin(), and must already be in the same body axes.
+*/
+class Estimator {
+private:
+  fp gyroScale;  ///< rad/s per count
+  fp accScale;   ///< g per count
+  fp kp,ki;      ///< Attitude correction gains
+  fp ix,iy,iz;   ///< Integral of attitude error, rad/s
+  fp mx,my,mz;   ///< Latest compass reading, unit vector
+  bool haveMag;
+  fp p0;         ///< Pressure at zero altitude, Pa
+  static fp invSqrt(fp x);
+public:
+  fp q0,q1,q2,q3; ///< Attitude, rotating the earth frame (z up) into the body frame
+  fp alt;         ///< Altitude above the first pressure reading, m
+  fp vz;          ///< Vertical velocity, m/s, up is positive
+  fp az;          ///< Vertical acceleration less gravity, m/s^2
+  fp baroAlt;     ///< Altitude from the last pressure reading alone, m
+  fp alpha,beta;  ///< Barometric correction gains
+  Estimator();
+  /**
+  \param LgyroScale rad/s per gyro count
+  \param LaccScale  g per accelerometer count
+  \param Lkp        Proportional gain of attitude correction
+  \param Lki        Integral gain of attitude correction
+  */
+  void begin(fp LgyroScale, fp LaccScale, fp Lkp=1.0f, fp Lki=0.01f);
+  /** Advance the state by one IMU sample
+  \param dt Time since the last sample, s
+  */
+  void updateImu(int16_t gx, int16_t gy, int16_t gz, int16_t ax, int16_t ay, int16_t az, fp dt);
+  /** Use a new compass reading in the following IMU updates. Any scale will do. */
+  void updateMag(int16_t bx, int16_t by, int16_t bz);
+  /** Correct altitude and velocity with a pressure reading. The first reading
+  sets zero altitude. */
+  void updateBaro(int32_t pressure);
+  static fp altitude(fp pressure, fp p0);
+};
+
+#endif
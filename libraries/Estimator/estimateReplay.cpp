@@ -0,0 +1,87 @@
+/* Host side replay of a recorded Rocketometer log through the onboard state
+estimator, so that it can be tuned on real flight data and its cost measured.
+
+Usage: estimateReplay <log.sds> [PCLK] > state.csv
+
+Reads the packets in the log, feeds IMU (0x10), compass (0x04) and pressure
+(0x0A) readings to an Estimator set up the same way as on board, and writes one
+CSV line of state for each IMU packet. Time between IMU packets is taken from
+their timestamps, which count PCLK ticks and wrap every second. At the end, it
+reports the average host time per IMU step on stderr.
+
+Packets are found with scanPackets() in packetScan.h, the same as downlinkRx
+and sourceExtract, so sync marks and any garbage in the log are skipped.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+#include "Estimator.h"
+#include "packetScan.h"
+
+static int16_t  get16(const uint8_t* p) {return (int16_t)((p[0]<<8) | p[1]);}
+static uint32_t get32(const uint8_t* p) {return ((uint32_t)p[0]<<24) | ((uint32_t)p[1]<<16) | ((uint32_t)p[2]<<8) | p[3];}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+int main(int argc, char** argv) {
+  if(argc<2) {
+    fprintf(stderr,"Usage: %s <log.sds> [PCLK]\n",argv[0]);
+    return 1;
+  }
+  FILE* inf=fopen(argv[1],"rb");
+  if(!inf) {
+    perror(argv[1]);
+    return 1;
+  }
+  uint32_t pclk=argc>2?strtoul(argv[2],nullptr,0):60000000;
+  fseek(inf,0,SEEK_END);
+  long size=ftell(inf);
+  fseek(inf,0,SEEK_SET);
+  uint8_t* buf=(uint8_t*)malloc(size+6);
+  if(fread(buf,1,size,inf)!=(size_t)size) {
+    perror(argv[1]);
+    return 1;
+  }
+  fclose(inf);
+  //Same scales as the MPU6050 is set to on board, +-2000deg/s and +-16g
+  Estimator est;
+  est.begin(3.14159265f/180.0f/16.4f,1.0f/2048.0f);
+  bool haveTC=false;
+  uint32_t lastTC=0;
+  double cpu=0;
+  uint32_t steps=0;
+  printf("tc,q0,q1,q2,q3,alt,vz,az,baroAlt\n");
+  scanPackets(buf,(int)size,true,[&](const uint8_t* p, int len) {
+    int apid=((p[0]<<8) | p[1]) & 0x7FF;
+    bool hasTC=(p[0] & 0x08)!=0;
+    if(!hasTC) return;
+    uint32_t tc=get32(p+6);
+    const uint8_t* d=p+10;
+    if(apid==0x10 && len>=10+14) {
+      if(!haveTC) {
+        haveTC=true;
+        lastTC=tc;
+        return;
+      }
+      uint32_t ticks=(tc>=lastTC)?tc-lastTC:tc+pclk-lastTC;
+      lastTC=tc;
+      double t0=now();
+      est.updateImu(get16(d+6),get16(d+8),get16(d+10),get16(d+0),get16(d+2),get16(d+4),(fp)ticks/pclk);
+      cpu+=now()-t0;
+      steps++;
+      printf("%u,%f,%f,%f,%f,%f,%f,%f,%f\n",tc,est.q0,est.q1,est.q2,est.q3,est.alt,est.vz,est.az,est.baroAlt);
+    } else if(apid==0x04 && len>=10+6) {
+      est.updateMag(get16(d+0),get16(d+2),get16(d+4));
+    } else if(apid==0x0A && len>=10+12) {
+      est.updateBaro((int32_t)get32(d+8));
+    }
+  });
+  if(steps>0) fprintf(stderr,"%u IMU steps, %.3f us per step on this host\n",steps,cpu/steps*1e6);
+  free(buf);
+  return 0;
+}
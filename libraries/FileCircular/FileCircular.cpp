@@ -1,8 +1,30 @@
 #include "FileCircular.h"
 
+bool FileCircular::drain() {
+  errno=0;
+  if(ouf.busy()) {
+    busySkips++;
+    return false;
+  }
+  if(dirPending) {
+    //Either way, no data was written. On failure, errno is set.
+    sync();
+    return false;
+  }
+  if(readylen()<blockSize) return false;
+  return drainCore();
+}
+
 bool FileCircular::drainCore() {
-  if(!ouf.append(buf+tail)) FAIL(ouf.errno*100+1);
+  if(!ouf.append(buf+tail,false)) FAIL(ouf.errno*100+1);
+  dirPending=true;
   fullState=false;
   tail=(tail+blockSize)%N;
   return true;
 }
+
+bool FileCircular::sync() {
+  dirPending=false;
+  if(!ouf.sync()) FAIL(ouf.errno*100+2);
+  return true;
+}
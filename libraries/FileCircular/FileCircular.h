@@ -4,19 +4,46 @@
 #include "file.h"
 #include "Circular.h"
 
+/* Circular buffer which drains to a file one block at a time. The program
+supplies the buffer, so it decides how much RAM to give it. The size must be a
+whole number of blocks, and at least two, so that one block can be written
+while the next fills.
+
+Writing a block to the card is split in two. Handing the block to the card takes
+only as long as it takes to clock 512 bytes over SPI, after which that part of
+the buffer is free again. The card then spends a long time (up to hundreds of
+milliseconds on a cheap card) programming the block, and while it does, drain()
+doesn't wait. It returns false straight away so the main loop can carry on, and
+the buffer carries on filling. Call busy() to check for that state.
+
+The directory entry, which holds the file size, is written by its own drain()
+call after each block, so that it doesn't have to wait for the block either.
+*/
 class FileCircular: public Circular {
 private:
   bool drainCore();
   static const int blockSize=SDHC::BLOCK_SIZE;
-  static const int bufSize=blockSize*8;
-  char buf[bufSize];
+  bool dirPending;     ///< A block has been appended but the directory entry hasn't been written since
+  uint32_t busySkips;  ///< Number of drain() calls which found the card still busy
 protected:
   File& ouf;
 public:
   unsigned int errno;
-  FileCircular(File& Louf):Circular(sizeof(buf),buf),ouf(Louf) {};
-
-  bool drain() {errno=0;if(readylen()>=blockSize) return drainCore();return false;};
+  /**
+  \param Louf File to write to
+  \param LN   Size of buffer, a multiple of blockSize
+  \param Lbuf Buffer
+  */
+  FileCircular(File& Louf, uint32_t LN, char* Lbuf):Circular(LN,Lbuf),dirPending(false),busySkips(0),ouf(Louf),errno(0) {};
+  /** Write at most one block, or the directory entry, without waiting for the card
+  \return true if a block of data was written, false if not, either because there
+  wasn't a whole block ready, the card was busy, or there was an error (errno!=0)
+  */
+  bool drain() override;
+  /** Write the directory entry now if it is behind, waiting for the card if needed */
+  bool sync();
+  bool busy() {return ouf.busy();};
+  uint32_t getBusySkips() {return busySkips;};
 };
 
 #endif
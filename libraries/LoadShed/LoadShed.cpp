@@ -0,0 +1,46 @@
+#include "LoadShed.h"
+#include "Time.h"
+#include "LPC214x.h"
+#include "dtc.h"
+
+LoadShed::LoadShed(Circular& Lq, int Ltimer, uint32_t Lunit, uint8_t LmaxLevel):q(Lq),timer(Ltimer),unit(Lunit),level(0),maxLevel(LmaxLevel),
+  lastTC(0),wait(0),sinceChange(0),calm(0),reason(0) {
+  begin();
+}
+
+void LoadShed::begin(uint8_t LhighFill, uint8_t LlowFill, uint32_t maxWaitMs, uint32_t upHoldMs, uint32_t downHoldMs) {
+  const uint32_t ticksPerMs=Time::PCLK/1000;
+  highFill=LhighFill;
+  lowFill=LlowFill;
+  maxWait=maxWaitMs*ticksPerMs;
+  upHold=upHoldMs*ticksPerMs;
+  downHold=downHoldMs*ticksPerMs;
+  lastTC=TTC(timer);
+}
+
+//Add without wrapping around, so that long quiet spells don't look short
+static uint32_t satAdd(uint32_t a, uint32_t b) {
+  return (a+b<a)?0xFFFFFFFF:a+b;
+}
+
+bool LoadShed::update() {
+  uint32_t tc=TTC(timer);
+  uint32_t dt=dtc(lastTC,tc,timer);
+  lastTC=tc;
+  if((uint32_t)q.readylen()<unit) wait=0; else wait=satAdd(wait,dt);
+  sinceChange=satAdd(sinceChange,dt);
+  uint8_t fill=getFill();
+  if(fill<lowFill && wait<maxWait) calm=satAdd(calm,dt); else calm=0;
+  if(level<maxLevel && sinceChange>=upHold && (fill>highFill || wait>=maxWait)) {
+    level++;
+    reason=(fill>highFill)?reasonFill:reasonWait;
+  } else if(level>0 && calm>=downHold) {
+    level--;
+    reason=reasonCalm;
+  } else {
+    return false;
+  }
+  sinceChange=0;
+  calm=0;
+  return true;
+}
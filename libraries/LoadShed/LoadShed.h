@@ -0,0 +1,71 @@
+#ifndef LOADSHED_H
+#define LOADSHED_H
+
+#include <inttypes.h>
+#include "Circular.h"
+
+/* Load shedding controller for a data logger. It watches the buffer between the
+sensors and the storage, and picks a shed level, from 0 (full rate) up to
+maxLevel. The program reduces its data rate by a factor of 2^level, say by
+averaging that many samples into each packet, so that when storage can't keep
+up the data gets uniformly coarser rather than full of gaps.
+
+The level goes up one step when the buffer is more than highFill percent full,
+or it has had at least one drainable unit (say a block, for a FileCircular)
+ready for more than maxWaitMs without a drain. It goes up
+no more than once every upHoldMs, so each step gets a chance to take effect.
+The level comes down one step once the buffer has stayed under lowFill percent
+with no long waits for downHoldMs. That is normally much longer than upHoldMs,
+so the rate doesn't flap when the card is on the edge.
+
+Call drained() each time the buffer is drained, and update() once per sample
+before deciding what to record.
+*/
+class LoadShed {
+private:
+  Circular& q;
+  int timer;
+  uint32_t unit;             ///< Least amount of ready data which the drain will take
+  uint8_t level;
+  uint8_t maxLevel;
+  uint8_t highFill,lowFill;  ///< Percent of buffer size
+  uint32_t maxWait;          ///< Ticks
+  uint32_t upHold,downHold;  ///< Ticks
+  uint32_t lastTC;
+  uint32_t wait;             ///< Ticks since the last drain with a unit of data waiting
+  uint32_t sinceChange;      ///< Ticks since the level last changed
+  uint32_t calm;             ///< Ticks the buffer has been under lowFill
+  uint8_t reason;
+public:
+  //Why the level last changed
+  static const uint8_t reasonFill=1;
+  static const uint8_t reasonWait=2;
+  static const uint8_t reasonCalm=3;
+  /**
+  \param Lq        Buffer to watch
+  \param Ltimer    Timer used to measure time
+  \param Lunit     Least amount of ready data the drain will take
+  \param LmaxLevel Highest shed level
+  */
+  LoadShed(Circular& Lq, int Ltimer, uint32_t Lunit, uint8_t LmaxLevel=3);
+  /** Set the thresholds
+  \param LhighFill  Shed more if the buffer is fuller than this, percent
+  \param LlowFill   Shed less after the buffer has stayed emptier than this, percent
+  \param maxWaitMs  Shed more if data has waited this long for a drain
+  \param upHoldMs   Least time between steps up in level
+  \param downHoldMs Time the buffer has to stay calm for each step down in level
+  */
+  void begin(uint8_t LhighFill=50, uint8_t LlowFill=12, uint32_t maxWaitMs=250, uint32_t upHoldMs=100, uint32_t downHoldMs=2000);
+  void drained() {wait=0;};
+  /** Check the buffer and maybe change level
+  \return true if the level changed
+  */
+  bool update();
+  uint8_t getLevel()     {return level;};
+  uint32_t decimation()  {return 1U<<level;};
+  uint8_t getReason()    {return reason;};
+  uint8_t getFill()      {return (uint8_t)((q.size()-1-q.freelen())*100/q.size());}; ///< Percent of buffer in use
+  uint32_t getWait()     {return wait;}; ///< Ticks data has been waiting for a drain
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include <string.h>
+#include "BlockCache.h"
+
+void BlockCache::invalidate() {
+  for(int i=0;i<BLOCKCACHE_SLOTS;i++) slot[i].lastUse=0;
+}
+
+BlockCache::Slot* BlockCache::find(uint32_t block) {
+  for(int i=0;i<BLOCKCACHE_SLOTS;i++) {
+    if(slot[i].lastUse>0 && slot[i].block==block) return &slot[i];
+  }
+  return nullptr;
+}
+
+//Empty slots have lastUse==0, so they are always used first
+BlockCache::Slot* BlockCache::lru() {
+  Slot* result=&slot[0];
+  for(int i=1;i<BLOCKCACHE_SLOTS;i++) {
+    if(slot[i].lastUse<result->lastUse) result=&slot[i];
+  }
+  return result;
+}
+
+bool BlockCache::read(uint32_t block, char* buf, int start, int len) {
+  if(start+len>SDHC::BLOCK_SIZE) FAIL(1);
+  Slot* s=find(block);
+  if(s) {
+    hits++;
+  } else {
+    misses++;
+    s=lru();
+    s->lastUse=0; //In case the read fails, don't leave half a block marked valid
+    busBytes+=blockBusBytes;
+    if(!sd.read(block,s->data)) FAIL(sd.errno*100+2);
+    s->block=block;
+  }
+  s->lastUse=++useCount;
+  memcpy(buf,s->data+start,len);
+  return true;
+}
+
+//Whole block read which is served from the cache if it is there, but doesn't
+//put the block in the cache if it isn't
+bool BlockCache::readUncached(uint32_t block, char* buf) {
+  Slot* s=find(block);
+  if(s) {
+    hits++;
+    s->lastUse=++useCount;
+    memcpy(buf,s->data,SDHC::BLOCK_SIZE);
+    return true;
+  }
+  misses++;
+  busBytes+=blockBusBytes;
+  if(!sd.read(block,buf)) FAIL(sd.errno*100+7);
+  return true;
+}
+
+bool BlockCache::write(uint32_t block, const char* buf, uint32_t trace) {
+  Slot* s=find(block);
+  if(s) {
+    if(writeThrough) {
+      if(s->data!=buf) memcpy(s->data,buf,SDHC::BLOCK_SIZE);
+      s->lastUse=++useCount;
+    } else {
+      s->lastUse=0;
+    }
+  }
+  busBytes+=blockBusBytes;
+  if(!sd.write(block,buf,trace)) {
+    //Don't know what is on the card now
+    if(s) s->lastUse=0;
+    FAIL(sd.errno*100+3);
+  }
+  return true;
+}
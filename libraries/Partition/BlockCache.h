@@ -0,0 +1,72 @@
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include <inttypes.h>
+#include "sdhc.h"
+
+/* Small LRU cache of whole SD blocks. The SD card always clocks a whole block
+(plus CRC) over SPI, even when the caller only wants a few bytes of it, and the
+filesystem reads the same few blocks (MBR, boot sector, FAT sectors, directory
+sectors) over and over. Any read, partial or whole, of a block in the cache is
+served from RAM. A read of a block not in the cache reads the whole block into
+the least recently used slot, then serves the read from there.
+
+File data and directory sectors are read with readUncached() instead. On a miss,
+it reads the block straight into the caller's buffer and leaves the cache alone.
+File data is rarely read twice, and DirEntry keeps its own copy of the
+directory sector it is working in, so putting them in the cache would only push
+out the FAT sectors, which are read over and over.
+
+Writes always go to the card. In write-through mode, a cached copy of the block
+is updated as well. Otherwise, a cached copy is thrown away. A write never puts
+a block into the cache which wasn't there already, so streaming writes of file
+data don't push out the filesystem blocks.
+
+Each slot takes one block of RAM. The number of slots may be changed in the
+program Makefile like this:
+
+CDEFS += -DBLOCKCACHE_SLOTS=4
+*/
+#ifndef BLOCKCACHE_SLOTS
+#define BLOCKCACHE_SLOTS 2
+#endif
+
+class BlockCache {
+private:
+  struct Slot {
+    char data[SDHC::BLOCK_SIZE];
+    uint32_t block;
+    uint32_t lastUse; ///< Value of useCount when this slot was last touched, 0 if the slot is empty
+  };
+  Slot slot[BLOCKCACHE_SLOTS];
+  SDHC& sd;
+  uint32_t useCount;
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t busBytes;
+  //Command, start token, data, and CRC
+  static const uint32_t blockBusBytes=6+1+SDHC::BLOCK_SIZE+2;
+  Slot* find(uint32_t block);
+  Slot* lru();
+public:
+  bool writeThrough; ///< If true, writes update cached blocks. If false, writes invalidate them.
+  unsigned int errno;
+  BlockCache(SDHC& Lsd):sd(Lsd),useCount(0),hits(0),misses(0),busBytes(0),writeThrough(true),errno(0) {invalidate();};
+  bool read(uint32_t block, char* buf) {return read(block,buf,0,SDHC::BLOCK_SIZE);};
+  bool read(uint32_t block, char* buf, int start, int len);
+  bool readUncached(uint32_t block, char* buf);
+  bool write(uint32_t block, const char* buf, uint32_t trace);
+  //Streaming reads bypass the cache. Since the cache never holds anything newer
+  //than the card, there is nothing to flush first.
+  bool readStart(uint32_t block) {busBytes+=6;if(!sd.readStart(block)) FAIL(sd.errno*100+4);return true;};
+  bool readNext(char* buf) {busBytes+=1+SDHC::BLOCK_SIZE+2;if(!sd.readNext(buf)) FAIL(sd.errno*100+5);return true;};
+  bool readStop() {busBytes+=6;if(!sd.readStop()) FAIL(sd.errno*100+6);return true;};
+  bool busy() {return sd.busy();}; ///< Card is still programming the last block written
+  void invalidate();
+  uint32_t getHits()     {return hits;};
+  uint32_t getMisses()   {return misses;};
+  uint32_t getBusBytes() {return busBytes;}; ///< Bytes clocked over SPI for block transfers, both reads and writes
+  void resetStats() {hits=0;misses=0;busBytes=0;};
+};
+
+#endif
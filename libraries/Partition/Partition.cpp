@@ -1,10 +1,10 @@
 #include "Partition.h"
 
 bool Partition::begin(int index) {
-  if(!sd.read(0,mbr,0x1fe,2)) FAIL(sd.errno*100+1);
+  if(!cache.read(0,mbr,0x1fe,2)) FAIL(cache.errno*100+1);
   if(mbr[0x0]!=0x55) FAIL(2);
   if(mbr[0x1]!=0xAA) FAIL(3);
-  if(!sd.read(0,mbr,(index-1)*0x10+0x1be,16)) FAIL(sd.errno*100+4);
+  if(!cache.read(0,mbr,(index-1)*0x10+0x1be,16)) FAIL(cache.errno*100+4);
   return true;
 }
 
@@ -32,6 +32,6 @@ void Partition::print(Print &out) {
 }
 
 bool Partition::write(const uint32_t block, const char* buf, uint32_t trace) {
-  ASSERT(sd.write(block+lba_start,buf,trace),sd.errno*100+7);
+  ASSERT(cache.write(block+lba_start,buf,trace),cache.errno*100+7);
 };
 
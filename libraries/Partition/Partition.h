@@ -3,6 +3,7 @@
 
 #include <inttypes.h>
 #include "sdhc.h"
+#include "BlockCache.h"
 
 class Partition {
   //We completely ignore the CHS addresses - SD cards don't even have heads 
@@ -21,12 +22,12 @@ private:
       uint32_t lba_start __attribute__((packed));
       uint32_t lba_length __attribute__((packed));
     };
-    char mbr[];
+    char mbr[16];
   };
-  SDHC &sd;
 public:
+  BlockCache cache; ///< All reads and writes of the card go through here
   int errno;
-  Partition(SDHC &Lsd):sd(Lsd) {};
+  Partition(SDHC &Lsd):cache(Lsd) {};
   uint16_t first_cylinder() {return ((uint16_t)(cs0&0xC0))<<2 | c0;};
   uint8_t first_head() {return h0;};
   uint8_t first_sector() {return cs0 & 0x3F;};
@@ -35,9 +36,14 @@ public:
   uint8_t last_sector() {return cs1 & 0x3F;};
   bool begin(int index);
   void print(Print &out);
-  bool read(const uint32_t block, char* buf) {ASSERT(sd.read(block+lba_start,buf),sd.errno*100+5);};
-  bool read(const uint32_t block, char* buf, int start, int len) {ASSERT(sd.read(block+lba_start,buf,start,len),sd.errno*100+6);};
+  bool read(const uint32_t block, char* buf) {ASSERT(cache.read(block+lba_start,buf),cache.errno*100+5);};
+  bool read(const uint32_t block, char* buf, int start, int len) {ASSERT(cache.read(block+lba_start,buf,start,len),cache.errno*100+6);};
+  bool readUncached(const uint32_t block, char* buf) {ASSERT(cache.readUncached(block+lba_start,buf),cache.errno*100+11);};
   bool write(const uint32_t block, const char* buf, uint32_t trace);
+  bool readStart(const uint32_t block) {ASSERT(cache.readStart(block+lba_start),cache.errno*100+8);};
+  bool readNext(char* buf) {ASSERT(cache.readNext(buf),cache.errno*100+9);};
+  bool readStop() {ASSERT(cache.readStop(),cache.errno*100+10);};
+  bool busy() {return cache.busy();};
 };
 
 #endif
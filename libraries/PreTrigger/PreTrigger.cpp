@@ -0,0 +1,21 @@
+#include <string.h>
+#include "PreTrigger.h"
+
+void PreTrigger::push(const void* rec) {
+  if(frozen) return;
+  memcpy(buf+next*recSize,rec,recSize);
+  next++;
+  if(next>=capacity) next=0;
+  if(count<capacity) count++;
+}
+
+/** Take the oldest record out of the history
+\return true if a record was copied to rec, false if the history is empty
+*/
+bool PreTrigger::pop(void* rec) {
+  if(count==0) return false;
+  uint32_t oldest=(next+capacity-count)%capacity;
+  memcpy(rec,buf+oldest*recSize,recSize);
+  count--;
+  return true;
+}
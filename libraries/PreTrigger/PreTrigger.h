@@ -0,0 +1,41 @@
+#ifndef PRETRIGGER_H
+#define PRETRIGGER_H
+
+#include <inttypes.h>
+
+/* Pre-trigger history. Holds the most recent records (say, full rate sensor
+samples) pushed into it, overwriting the oldest once it is full, so that when
+something interesting happens the lead-up to it can still be recorded.
+
+When the trigger fires, call freeze(). From then on push() is ignored, and the
+held records can be taken out oldest first with pop() at whatever pace the
+storage can take. Once the program is done with the event and the history has
+been emptied, call rearm() to start recording again.
+
+The program supplies the buffer, which holds capacity records of recSize bytes
+each, so the length of the history is fixed at compile time by the program.
+*/
+class PreTrigger {
+private:
+  char* buf;
+  uint32_t recSize;
+  uint32_t capacity;
+  uint32_t next;     ///< Slot the next record will go in
+  uint32_t count;    ///< Number of records held
+  bool frozen;
+public:
+  /**
+  \param LrecSize  Size of each record in bytes
+  \param Lcapacity Number of records which will fit in the buffer
+  \param Lbuf      Buffer of at least LrecSize*Lcapacity bytes
+  */
+  PreTrigger(uint32_t LrecSize, uint32_t Lcapacity, char* Lbuf):buf(Lbuf),recSize(LrecSize),capacity(Lcapacity),next(0),count(0),frozen(false) {};
+  void push(const void* rec);
+  bool pop(void* rec);
+  void freeze() {frozen=true;};
+  void rearm() {frozen=false;count=0;};
+  bool isFrozen() {return frozen;};
+  uint32_t available() {return count;}; ///< Number of records held
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef BufferedPrint_h
+#define BufferedPrint_h
+
+#include <string.h>
+#include "Print.h"
+
+/* Collects printed output on the stack and passes it on to another Print in
+bulk. Every print() ends up as one or more virtual write() calls, so a line of
+CSV made of a couple dozen print() calls costs a hundred or so calls into the
+port. Through one of these, it costs one bulk write(buf,len) per N characters,
+which a port can handle much more efficiently, for instance by filling a whole
+hardware FIFO at once.
+
+  {
+    BufferedPrint<128> line(Serial);
+    line.print(a);line.print(",");line.println(b);
+  } //Whatever is left is written when line goes out of scope
+
+The buffer is written when it fills, when flush() is called, and when the
+object is destroyed.
+*/
+template<size_t N=64>
+class BufferedPrint: public Print {
+private:
+  Print& ouf;
+  char buf[N];
+  size_t len;
+public:
+  BufferedPrint(Print& Louf):ouf(Louf),len(0) {};
+  ~BufferedPrint() {flush();};
+  void flush() {
+    if(len>0) ouf.write(buf,len);
+    len=0;
+  };
+  void write(unsigned char c) override {
+    if(len>=N) flush();
+    buf[len++]=c;
+  };
+  void write(const char* in, size_t size) override {
+    if(len+size>N) flush();
+    //Too big to ever fit, so don't bother copying it
+    if(size>=N) {
+      ouf.write(in,size);
+      return;
+    }
+    memcpy(buf+len,in,size);
+    len+=size;
+  };
+  using Print::write;
+};
+
+#endif
@@ -31,51 +31,130 @@ const int BIN=2;
 const int BYTE=0;
 
 #include <stdarg.h>
+#include <string.h>
 
 class Print {
 private:
-  void printNumber(uint32_t n, int base=DEC, int digits=0) {
-    unsigned char buf[8 * sizeof(uint32_t)];
-    size_t i = 0;
-
-    if (n == 0) {
-      for(i=0;i<(digits>0?digits:1);i++) print('0');
-      return;
+  //Digits are formatted from the right into a buffer on the stack, then
+  //written with one call. Decimal goes two digits at a time from this table,
+  //and the divide by 100 for each pair is a multiply by the reciprocal, since
+  //divides are slow library calls on ARM7. Power-of-two bases are shifts and masks.
+  static constexpr char digitPairs[201]=
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+  static char digitChar(uint32_t d) {return d<10?'0'+d:'A'+d-10;};
+  static int log2Base(int base) {
+    switch(base) {
+      case BIN: return 1;
+      case OCT: return 3;
+      case HEX: return 4;
     }
-
-    while (n > 0||digits>0) {
-      buf[i] = n % base;
-      i++;
-      digits--;
-      n /= base;
+    return 0;
+  }
+  //n/10 and n%10 with shifts and adds, good for any 64-bit n
+  static uint64_t div10(uint64_t n, uint32_t& r) {
+    uint64_t q=(n>>1)+(n>>2);
+    q+=q>>4;
+    q+=q>>8;
+    q+=q>>16;
+    q+=q>>32;
+    q>>=3;
+    uint64_t rr=n-((q<<2)+q)*2;
+    while(rr>9) {q++;rr-=10;}
+    r=rr;
+    return q;
+  }
+  //Each of these puts the digits of n just before end, and returns where they start
+  static char* formatDec(uint32_t n, char* end) {
+    while(n>=100) {
+      uint32_t q=(uint32_t)(((uint64_t)n*0x51EB851FU)>>37); //n/100 for all 32-bit n
+      uint32_t r=n-q*100;
+      end-=2;
+      end[0]=digitPairs[r*2];
+      end[1]=digitPairs[r*2+1];
+      n=q;
     }
-
-    for (; i > 0; i--) print((char) (buf[i - 1] < 10 ?'0' + buf[i - 1]:'A' + buf[i - 1] - 10));
+    if(n>=10) {
+      end-=2;
+      end[0]=digitPairs[n*2];
+      end[1]=digitPairs[n*2+1];
+    } else {
+      *--end='0'+n;
+    }
+    return end;
+  }
+  static char* formatDec(uint64_t n, char* end) {
+    while(n>0xFFFFFFFFULL) {
+      uint32_t r;
+      n=div10(n,r);
+      *--end='0'+r;
+    }
+    return formatDec((uint32_t)n,end);
+  }
+  template<typename T> static char* formatShift(T n, int shift, char* end) {
+    uint32_t mask=(1U<<shift)-1;
+    do {
+      *--end=digitChar((uint32_t)n & mask);
+      n>>=shift;
+    } while(n>0);
+    return end;
   }
-  void printNumber(uint64_t n, int base=DEC, int digits=0) {
-    unsigned char buf[8 * sizeof(uint64_t)];
-    size_t i = 0;
-    char pad;
-    if(digits>0) {
-      pad='0';
+  template<typename T> static char* formatAny(T n, int base, char* end) {
+    do {
+      *--end=digitChar(n%base);
+      n/=base;
+    } while(n>0);
+    return end;
+  }
+  /** Pad out the digits from p to end, put on the sign, and write the whole thing
+  \param buf    start of the buffer the digits are in, so padding doesn't run off the front
+  \param digits if positive, pad with leading zeros to this many digits. If negative,
+                pad with leading spaces to this many characters. */
+  void writeNumber(char* buf, char* p, char* end, int digits, bool neg) {
+    if(digits>=0) {
+      while(end-p<digits && p>buf+1) *--p='0';
+      if(neg) *--p='-';
     } else {
-      pad=' ';
-      digits=-digits;
+      if(neg) *--p='-';
+      while(end-p<-digits && p>buf) *--p=' ';
     }
-    if (n == 0) {
-      for(i=0;i<(digits>0?digits:1);i++) print(pad);
-      return;
+    write(p,end-p);
+  }
+  void printNumber(uint32_t n, int base=DEC, int digits=0, bool neg=false) {
+    char buf[2+8*sizeof(uint32_t)];
+    char* end=buf+sizeof(buf);
+    char* p;
+    int shift=log2Base(base);
+    if(base==DEC) {
+      p=formatDec(n,end);
+    } else if(shift>0) {
+      p=formatShift(n,shift,end);
+    } else {
+      p=formatAny(n,base,end);
     }
-
-    while (n > 0||digits>0) {
-      buf[i] = n % base;
-      if(buf[i]>0) pad='0';
-      i++;
-      digits--;
-      n /= base;
+    writeNumber(buf,p,end,digits,neg);
+  }
+  void printNumber(uint64_t n, int base=DEC, int digits=0, bool neg=false) {
+    char buf[2+8*sizeof(uint64_t)];
+    char* end=buf+sizeof(buf);
+    char* p;
+    int shift=log2Base(base);
+    if(base==DEC) {
+      p=formatDec(n,end);
+    } else if(shift>0) {
+      p=formatShift(n,shift,end);
+    } else {
+      p=formatAny(n,base,end);
     }
-
-    for (; i > 0; i--) print((char) (buf[i - 1] < 10 ?'0' + buf[i - 1]:'A' + buf[i - 1] - 10));
+    writeNumber(buf,p,end,digits,neg);
   }
 
   void printFloat(float number, unsigned char digits) {
@@ -116,8 +195,10 @@ private:
 
 public:
   virtual void write(unsigned char) {};
+  //Strings go through the bulk write, so a port which can take a whole buffer
+  //at once only has to override that one
   virtual void write(const char *str) {
-    while (*str) write(*str++);
+    write(str,strlen(str));
   }
   virtual void write(const char *buffer, size_t size) {
     while (size--) write(*buffer++);
@@ -136,11 +217,7 @@ public:
     if (base == 0) {
       write(n);
     } else if (base == 10) {
-      if (n < 0) {
-        print('-');
-        n = -n;
-      }
-      printNumber((uint32_t)n, 10, digits);
+      printNumber(n<0?-(uint32_t)n:(uint32_t)n, 10, digits, n<0);
     } else {
       printNumber((uint32_t)n, base,digits);
     }
@@ -154,18 +231,14 @@ public:
     if (base == 0) {
       write(n);
     } else if (base == 10) {
-      if (n < 0) {
-        print('-');
-        n = -n;
-      }
-      printNumber((uint64_t)n, 10, digits);
+      printNumber(n<0?-(uint64_t)n:(uint64_t)n, 10, digits, n<0);
     } else {
       printNumber((uint64_t)n, base, digits);
     }
   }
   void print(uint64_t n, int base= DEC,int digits=0) {
     if (base == 0) write(n);
-    else printNumber(n, base);
+    else printNumber(n, base, digits);
   };
   void print(float n, int digits=2) {
     printFloat(n, digits);
@@ -191,11 +264,11 @@ public:
     print(n, base, digits);
     println();
   }
-  void println(long long int n, int base=DEC, int digits=0) {
+  void println(int64_t n, int base=DEC, int digits=0) {
     print(n, base,digits);
     println();
   }
-  void println(unsigned long long n, int base=DEC,int digits=0) {
+  void println(uint64_t n, int base=DEC,int digits=0) {
     print(n, base,digits);
     println();
   }
@@ -204,7 +277,7 @@ public:
     println();
   }
   void println(void) {
-    print('\r');print('\n');
+    write("\r\n",2);
   };
   void printf(char const *format, ...) {
     //#########################################################################
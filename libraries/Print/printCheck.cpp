@@ -0,0 +1,319 @@
+/* Host check of the integer formatting in Print.h against the code it
+replaced, which divided once per digit and wrote one character at a time.
+
+Usage: printCheck [-n cases] [-b loops] [-s seed]
+
+  -n  Number of random values for the equivalence check, default 200000. Each
+      is printed as int, uint32_t, int64_t, and uint64_t, in bases 2, 3, 8, 10,
+      16, and 36, with widths from -20 to 20.
+  -b  Prints per benchmark row, default 2000000
+  -s  Random seed, default 1
+
+Every output of Print.h must match a plain statement of what it should be:
+the digits, then for a positive width, leading zeros to that many digits (the
+sign not counted), or for a negative width, leading spaces to that many
+characters (the sign counted). Every output which differs from the old code
+must be one of the four known changes, each of which fixed a bug in the old
+code:
+
+  A  A 64-bit zero with no width was " ", and is now "0"
+  B  A negative width didn't pad 32-bit numbers at all, and now pads with spaces
+  C  print(uint64_t) dropped the width, and now uses it
+  D  A negative width zero-padded print(int64_t), like "00025CC25", and now
+     space-pads it, like "   25CC25". A zero came out as all spaces.
+
+Then it times both on some typical prints, and counts the calls to write()
+for each. The host divides much faster than an ARM7, which has no divide
+instruction at all, so the time saved here is much less than on the target.
+64-bit decimal, which on the target trades a library divide per digit for
+shifts and adds, can even come out slower here.
+
+Exit status is 0 if everything matched, 1 if not.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+#include <string>
+#include "Print.h"
+
+/** Print into a string, counting the calls to write() */
+class StringPrint: public Print {
+public:
+  std::string s;
+  uint32_t writes;
+  StringPrint():writes(0) {};
+  void write(unsigned char c) override {s+=(char)c;writes++;};
+  void write(const char* buf, size_t len) override {s.append(buf,len);writes++;};
+  using Print::write;
+  void clear() {s.clear();};
+};
+
+/** The number formatting from Print.h as it was, for reference */
+class OldPrint {
+private:
+  void printNumber(uint32_t n, int base=DEC, int digits=0) {
+    unsigned char buf[8 * sizeof(uint32_t)];
+    size_t i = 0;
+
+    if (n == 0) {
+      for(i=0;i<(digits>0?digits:1);i++) print('0');
+      return;
+    }
+
+    while (n > 0||digits>0) {
+      buf[i] = n % base;
+      i++;
+      digits--;
+      n /= base;
+    }
+
+    for (; i > 0; i--) print((char) (buf[i - 1] < 10 ?'0' + buf[i - 1]:'A' + buf[i - 1] - 10));
+  }
+  void printNumber(uint64_t n, int base=DEC, int digits=0) {
+    unsigned char buf[8 * sizeof(uint64_t)];
+    size_t i = 0;
+    char pad;
+    if(digits>0) {
+      pad='0';
+    } else {
+      pad=' ';
+      digits=-digits;
+    }
+    if (n == 0) {
+      for(i=0;i<(digits>0?digits:1);i++) print(pad);
+      return;
+    }
+
+    while (n > 0||digits>0) {
+      buf[i] = n % base;
+      if(buf[i]>0) pad='0';
+      i++;
+      digits--;
+      n /= base;
+    }
+
+    for (; i > 0; i--) print((char) (buf[i - 1] < 10 ?'0' + buf[i - 1]:'A' + buf[i - 1] - 10));
+  }
+public:
+  std::string s;
+  uint32_t writes;
+  OldPrint():writes(0) {};
+  virtual void write(unsigned char c) {s+=(char)c;writes++;};
+  void clear() {s.clear();};
+  void print(char c) {write(c);};
+  void print(int n, int base=DEC, int digits=0) {
+    if (base == 10) {
+      if (n < 0) {
+        print('-');
+        n = -n;
+      }
+      printNumber((uint32_t)n, 10, digits);
+    } else {
+      printNumber((uint32_t)n, base,digits);
+    }
+  }
+  void print(uint32_t n, int base=DEC, int digits=0) {
+    printNumber(n, base, digits);
+  }
+  void print(int64_t n, int base=DEC, int digits=0) {
+    if (base == 10) {
+      if (n < 0) {
+        print('-');
+        n = -n;
+      }
+      printNumber((uint64_t)n, 10, digits);
+    } else {
+      printNumber((uint64_t)n, base, digits);
+    }
+  }
+  void print(uint64_t n, int base= DEC,int digits=0) {
+    printNumber(n, base);
+  };
+};
+
+/** What the output should be */
+static std::string spec(uint64_t mag, bool neg, int base, int digits) {
+  std::string d;
+  do {
+    uint32_t r=mag%base;
+    d.insert(d.begin(),(char)(r<10?'0'+r:'A'+r-10));
+    mag/=base;
+  } while(mag>0);
+  if(digits>0) {
+    while((int)d.size()<digits) d.insert(d.begin(),'0');
+    if(neg) d.insert(d.begin(),'-');
+  } else {
+    if(neg) d.insert(d.begin(),'-');
+    while((int)d.size()<-digits) d.insert(d.begin(),' ');
+  }
+  return d;
+}
+
+static uint64_t rng;
+static uint64_t next() {
+  rng^=rng<<13;
+  rng^=rng>>7;
+  rng^=rng<<17;
+  return rng;
+}
+
+//A random value of random magnitude, so that short numbers come up as often as long ones
+static uint64_t randomValue() {
+  int bits=next()%65;
+  uint64_t v=next();
+  return bits==64?v:v & ((1ULL<<bits)-1);
+}
+
+enum Kind {K_INT,K_U32,K_I64,K_U64};
+static const char* kindName[]={"int","uint32_t","int64_t","uint64_t"};
+
+static StringPrint np;
+static OldPrint op;
+static uint32_t checked,changed[4],wrong,unexplained;
+
+static void check(Kind k, uint64_t v, int base, int digits) {
+  np.clear();op.clear();
+  uint64_t mag;
+  bool neg=false;
+  bool wide=(k==K_I64 || k==K_U64);
+  switch(k) {
+    case K_INT: {
+      int n=(int)(uint32_t)v;
+      np.print(n,base,digits);op.print(n,base,digits);
+      neg=(base==10 && n<0);
+      mag=neg?-(uint64_t)(int64_t)n:(base==10?(uint64_t)n:(uint64_t)(uint32_t)n);
+      break;
+    }
+    case K_U32: {
+      uint32_t n=(uint32_t)v;
+      np.print(n,base,digits);op.print(n,base,digits);
+      mag=n;
+      break;
+    }
+    case K_I64: {
+      int64_t n=(int64_t)v;
+      np.print(n,base,digits);op.print(n,base,digits);
+      neg=(base==10 && n<0);
+      mag=neg?-(uint64_t)n:(uint64_t)n;
+      break;
+    }
+    default: {
+      uint64_t n=v;
+      np.print(n,base,digits);op.print(n,base,digits);
+      mag=n;
+      break;
+    }
+  }
+  checked++;
+  std::string want=spec(mag,neg,base,digits);
+  if(np.s!=want) {
+    if(wrong<10) printf("print((%s)0x%" PRIX64 ",%d,%d) gave \"%s\", should be \"%s\"\n",kindName[k],v,base,digits,np.s.c_str(),want.c_str());
+    wrong++;
+  }
+  if(np.s==op.s) return;
+  int why;
+  if(wide && mag==0 && digits==0) {
+    why=0;
+  } else if(!wide && digits<0) {
+    why=1;
+  } else if(k==K_U64 && digits!=0) {
+    why=2;
+  } else if(k==K_I64 && digits<0) {
+    why=3;
+  } else {
+    if(unexplained<10) printf("print((%s)0x%" PRIX64 ",%d,%d) gave \"%s\", used to give \"%s\"\n",kindName[k],v,base,digits,np.s.c_str(),op.s.c_str());
+    unexplained++;
+    return;
+  }
+  changed[why]++;
+}
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+//Time the same prints through both, over a table of values made up front
+template<typename T> static void bench(const char* name, const T* v, uint32_t nv, uint32_t loops, int base, int digits) {
+  np.clear();op.clear();
+  np.writes=0;op.writes=0;
+  size_t nLen=0,oLen=0;
+  double t0=now();
+  for(uint32_t i=0;i<loops;i++) {
+    np.print(v[i%nv],base,digits);
+    if(np.s.size()>4096) {nLen+=np.s.size();np.clear();}
+  }
+  double t1=now();
+  for(uint32_t i=0;i<loops;i++) {
+    op.print(v[i%nv],base,digits);
+    if(op.s.size()>4096) {oLen+=op.s.size();op.clear();}
+  }
+  double t2=now();
+  nLen+=np.s.size();np.clear();
+  oLen+=op.s.size();op.clear();
+  printf("%-28s %8.1f %8.1f %6.2fx %7.2f %7.2f %s\n",name,(t2-t1)*1e9/loops,(t1-t0)*1e9/loops,(t2-t1)/(t1-t0),
+         (double)op.writes/loops,(double)np.writes/loops,nLen==oLen?"":"(lengths differ)");
+}
+
+int main(int argc, char** argv) {
+  uint32_t cases=200000;
+  uint32_t loops=2000000;
+  rng=1;
+  int opt;
+  while((opt=getopt(argc,argv,"n:b:s:"))!=-1) {
+    switch(opt) {
+      case 'n': cases=strtoul(optarg,nullptr,0);break;
+      case 'b': loops=strtoul(optarg,nullptr,0);break;
+      case 's': rng=strtoull(optarg,nullptr,0);if(rng==0) rng=1;break;
+      default:
+        fprintf(stderr,"Usage: %s [-n cases] [-b loops] [-s seed]\n",argv[0]);
+        return 1;
+    }
+  }
+
+  static const int bases[]={2,3,8,10,16,36};
+  for(uint32_t i=0;i<cases;i++) {
+    uint64_t v=randomValue();
+    if(next()%2) v=-v;
+    for(int b: bases) {
+      //Every width for some values, one random width for the rest
+      int lo=-20,hi=20;
+      if(i%64!=0) lo=hi=(int)(next()%41)-20;
+      for(int d=lo;d<=hi;d++) {
+        for(int k=K_INT;k<=K_U64;k++) check((Kind)k,v,b,d);
+      }
+    }
+  }
+  //The edges, where carries and signs go wrong
+  static const uint64_t edges[]={0,1,9,10,99,100,0x7FFFFFFF,0x80000000,0xFFFFFFFF,0x100000000ULL,
+                                 9999999999ULL,10000000000ULL,0x7FFFFFFFFFFFFFFFULL,0x8000000000000000ULL,0xFFFFFFFFFFFFFFFFULL};
+  for(uint64_t e: edges) for(int b: bases) for(int d=-20;d<=20;d++) for(int k=K_INT;k<=K_U64;k++) {
+    check((Kind)k,e,b,d);
+    check((Kind)k,-e,b,d);
+  }
+  printf("%u prints checked, %u wrong, %u changed for no known reason\n",checked,wrong,unexplained);
+  printf("Known changes: A %u, B %u, C %u, D %u\n",changed[0],changed[1],changed[2],changed[3]);
+
+  //Values like the ones the firmware prints: sensor readings, timer counts, and 64-bit times
+  static const uint32_t nv=4096;
+  static int      vInt[nv];
+  static uint32_t vU32[nv];
+  static int64_t  vI64[nv];
+  for(uint32_t i=0;i<nv;i++) {
+    vInt[i]=(int)(next()%65536)-32768;
+    vU32[i]=(uint32_t)next();
+    vI64[i]=(int64_t)(next()>>8);
+  }
+  printf("print                        old(ns)  new(ns) speedup  old wr  new wr\n");
+  bench("int, DEC",                vInt,nv,loops,DEC,0);
+  bench("uint32_t, DEC",           vU32,nv,loops,DEC,0);
+  bench("uint32_t, DEC, 10",       vU32,nv,loops,DEC,10);
+  bench("uint32_t, HEX, 8",        vU32,nv,loops,HEX,8);
+  bench("int64_t, DEC",            vI64,nv,loops,DEC,0);
+  bench("int64_t, HEX, 16",        vI64,nv,loops,HEX,16);
+  return (wrong==0 && unexplained==0)?0:1;
+}
@@ -26,7 +26,29 @@
 #include "Stream.h"
 #include "pinconnect.h"
 #include "scb.h"
+#include "vic.h"
+#include "Circular.h"
 
+/* The port can run in one of two modes:
+
+Polled (begin(baud)) - write() busy-waits for room in the transmit holding
+register for every byte, and read() looks directly at the receive FIFO. This
+needs nothing else and works with interrupts off, but a long line of text at a
+low baud rate holds up the caller for the whole time it takes to send.
+
+Buffered (begin(baud,txq,rxq)) - write() puts the byte in txq and returns. The
+UART interrupt moves data from txq into the 16-byte transmit FIFO whenever the
+FIFO empties, and moves received data from the receive FIFO into rxq. write()
+only waits if txq itself is full. The queues belong to the caller, so their
+size is up to the program:
+
+  char serialTxBuf[1024];
+  Circular serialTx(sizeof(serialTxBuf),serialTxBuf);
+  char serialRxBuf[64];
+  Circular serialRx(sizeof(serialRxBuf),serialRxBuf);
+  ...
+  Serial.begin(9600,serialTx,serialRx);
+*/
 template<int port>
 class HardwareSerial: public Stream {
 private:
@@ -49,8 +71,66 @@ private:
   static volatile uint32_t& UACR() {return (*(volatile uint32_t*)(UART0_BASE_ADDR+(port)*UART_BASE_DELTA + 0x20));}
   static volatile uint32_t& UFDR() {return (*(volatile uint32_t*)(UART0_BASE_ADDR+(port)*UART_BASE_DELTA + 0x28));}
   static volatile uint32_t& UTER() {return (*(volatile uint32_t*)(UART0_BASE_ADDR+(port)*UART_BASE_DELTA + 0x30));}
+  static const int fifoSize=16;
+  static inline Circular* txq=nullptr; ///< Transmit queue in buffered mode, null in polled mode
+  static inline Circular* rxq=nullptr; ///< Receive queue in buffered mode, null in polled mode
+  static inline uint32_t rxOverflow=0; ///< Number of received bytes thrown away because rxq was full
+  //Move as much as will fit from txq into the transmit FIFO. Only call this when
+  //the FIFO is empty (THRE set) and with interrupts off or from the UART ISR.
+  static void fillTxFifo() {
+    for(int i=0;i<fifoSize && !txq->isEmpty();i++) UTHR()=txq->get();
+  }
+  //Start transmitting if the transmitter is idle. If it isn't, the THRE
+  //interrupt will pick up the queued data when the FIFO empties. Safe to call
+  //with interrupts on or off, so a write() from inside another interrupt
+  //handler can still make progress.
+  static void kickTx() {
+    uint32_t cpsr=irq_save();
+    if(ULSR() & 0x20) fillTxFifo();
+    irq_restore(cpsr);
+  }
+  static void handleISR() {
+    uint32_t iir;
+    //Bit 0 clear means an interrupt is pending. Reading IIR clears a THRE interrupt.
+    while(((iir=UIIR()) & 0x01)==0) {
+      switch(iir & 0x0E) {
+        case 0x06: //Receive line status - reading LSR clears it
+          ULSR();
+          break;
+        case 0x04: //Receive data available, FIFO at trigger level
+        case 0x0C: //Character timeout, data in FIFO but below trigger level
+          while(ULSR() & 0x01) {
+            char c=URBR();
+            //Check first rather than letting fill() fail, since a failed fill()
+            //leaves the queue marked full until someone drains it.
+            if(rxq->isFull()) {
+              rxOverflow++;
+            } else {
+              rxq->fill(c);
+              rxq->mark();
+            }
+          }
+          break;
+        case 0x02: //Transmit holding register empty
+          fillTxFifo();
+          break;
+      }
+    }
+  }
 public:
   HardwareSerial() {};
+  /** Start the port in buffered mode
+  \param baud Baud rate
+  \param Ltxq Queue for outgoing data
+  \param Lrxq Queue for incoming data
+  */
+  void begin(unsigned int baud, Circular& Ltxq, Circular& Lrxq) {
+    begin(baud);
+    txq=&Ltxq;
+    rxq=&Lrxq;
+    VIC.install(VIC.UART0+port,handleISR);
+    UIER()=0x03; //Interrupt on receive data available and THRE
+  };
   void begin(unsigned int baud) {
     //Set up the pins
     if(port==0) {
@@ -78,6 +158,13 @@ public:
     UIER()=0;
   };
   void end() {
+    if(txq) {
+      flush();
+      UIER()=0;
+      VIC.uninstall(VIC.UART0+port);
+      txq=nullptr;
+      rxq=nullptr;
+    }
     //set the pins to read (high Z)
     if(port==0) {
       PinConnect.set_pin(0,0); //TX0->GPIO
@@ -89,27 +176,71 @@ public:
   };
   void listen() {};
   int available(void) override {
+    if(rxq) return rxq->readylen();
     int result=((ULSR() & 0x01)>0)?1:0;
     return result;
   };
   int peek(void) override {
+    if(rxq) return rxq->isEmpty()?-1:(uint8_t)rxq->peekTail();
     //Peek not supported for a pure hardware read
     return -1;
   };
   int read(void) override {
+    if(rxq) return rxq->isEmpty()?-1:(uint8_t)rxq->get();
     if(available()>0) {
       return URBR();
     } else {
       return -1;
     }
   }
+  //Wait until everything written has gone out on the wire: in buffered mode
+  //the queue has been handed to the hardware, and the TX FIFO and shift
+  //register are empty (TEMT). The FIFOs are left alone, since resetting them
+  //would throw away bytes still waiting to go out, and received bytes.
   void flush(void) override {
-    UFCR()|=0x07;
+    if(txq) while(!txq->isEmpty()) kickTx();
+    while(!(ULSR() & 0x40)) ;
   }
   void write(uint8_t c) override {
+    if(txq) {
+      //If the queue is full, wait for the transmitter to make room. Keep
+      //kicking it ourselves in case interrupts are off.
+      while(txq->isFull()) kickTx();
+      txq->fill((char)c);
+      txq->mark();
+      kickTx();
+      return;
+    }
     while (!(ULSR() & 0x20));
     UTHR() = c;
   };
+  //Same as writing one byte at a time, but in buffered mode the queue is filled
+  //in as big pieces as will fit, and in polled mode the transmit FIFO is filled
+  //16 bytes at a time instead of waiting for each byte to go out.
+  void write(const char* buffer, size_t size) override {
+    if(txq) {
+      while(size>0) {
+        while(txq->isFull()) kickTx();
+        size_t n=txq->freelen();
+        if(n>size) n=size;
+        txq->fill(buffer,n);
+        txq->mark();
+        kickTx();
+        buffer+=n;
+        size-=n;
+      }
+      return;
+    }
+    while(size>0) {
+      //THRE means the whole FIFO is empty
+      while (!(ULSR() & 0x20));
+      for(int i=0;i<fifoSize && size>0;i++) {
+        UTHR() = *buffer++;
+        size--;
+      }
+    }
+  };
+  uint32_t getRxOverflow() {return rxOverflow;};
   using Print::write; // pull in write(str) and write(buf, size) from Print
 };
 
@@ -40,4 +40,19 @@ inline void disable_ints() {
   set_cpsr_c(get_cpsr_c() | (I_Bit|F_Bit));
 }
 
+//Critical section which is safe to use whether or not IRQs are already
+//disabled, IE both from normal code and from inside an interrupt handler.
+//Use like this:
+//  uint32_t cpsr=irq_save();
+//  ...touch things shared with an ISR...
+//  irq_restore(cpsr);
+inline uint32_t irq_save() {
+  uint32_t cpsr=get_cpsr_c();
+  set_cpsr_c(cpsr | I_Bit);
+  return cpsr;
+}
+inline void irq_restore(uint32_t cpsr) {
+  set_cpsr_c(cpsr);
+}
+
 #endif
@@ -0,0 +1,102 @@
+#ifndef IRQSTATS_H
+#define IRQSTATS_H
+
+#include <cinttypes>
+#include "irq.h"
+#include "LPC214x.h"
+#include "dtc.h"
+
+/* Interrupt occupancy and timer task lateness, for proving that interrupt
+deadlines are being met. Off unless the program Makefile has
+
+CDEFS += -DIRQ_STATS
+
+in which case IRQ_Wrapper times every handler it dispatches against Timer0, and
+DirectTaskManager records how long after its match value each task actually
+started. All of this is kept in a fixed table, written only from inside
+interrupts. The main loop takes a copy with snapshot(), which also starts the
+counts over, and logs it however it likes.
+
+Durations and lateness are in Timer0 ticks, and sums are 32 bits, so take a
+snapshot at least every minute or so.
+*/
+class IrqStats {
+public:
+  static const int nSources=32; ///< VIC source channels
+  static const int nChannels=4; ///< Timer match channels
+  struct Source {
+    uint32_t count;    ///< Times the handler was dispatched
+    uint32_t maxTicks; ///< Longest time in the handler
+    uint32_t sumTicks; ///< Total time in the handler
+  };
+  struct Late {
+    uint32_t count;    ///< Tasks which fired on this match channel
+    uint32_t maxTicks; ///< Latest that one started after its match value
+    uint32_t sumTicks;
+  };
+  struct Table {
+    Source source[nSources];
+    Late late[nChannels];
+    uint32_t unknown;  ///< Dispatches to a handler which wasn't installed through VICDriver, IE the default handler
+    uint32_t busyTicks;///< Total time in all handlers
+  };
+private:
+  Table t;
+  //Installed handlers in the order they were installed, which is VIC slot and
+  //therefore priority order, so the ones which run most are found soonest.
+  fvoid handler[16];
+  uint8_t handlerSource[16];
+  int nHandlers;
+  static void add(uint32_t& count, uint32_t& maxTicks, uint32_t& sumTicks, uint32_t ticks) {
+    count++;
+    sumTicks+=ticks;
+    if(ticks>maxTicks) maxTicks=ticks;
+  };
+  void clear() {
+    for(int i=0;i<nSources;i++) t.source[i]=Source{0,0,0};
+    for(int i=0;i<nChannels;i++) t.late[i]=Late{0,0,0};
+    t.unknown=0;
+    t.busyTicks=0;
+  };
+public:
+  IrqStats():nHandlers(0) {clear();};
+  /** Called by VICDriver::install() so a handler address can be traced back to its source */
+  void installed(unsigned int source, fvoid h) {
+    for(int i=0;i<nHandlers;i++) if(handler[i]==h) {handlerSource[i]=source;return;}
+    if(nHandlers>=16) return;
+    handler[nHandlers]=h;
+    handlerSource[nHandlers]=source;
+    nHandlers++;
+  };
+  uint32_t now() {return TTC(0);};
+  /** Called by IRQ_Wrapper after handler h, which was started at Timer0 count tc0, returns */
+  void dispatched(fvoid h, uint32_t tc0) {
+    uint32_t ticks=dtc(tc0,TTC(0));
+    t.busyTicks+=ticks;
+    for(int i=0;i<nHandlers;i++) if(handler[i]==h) {
+      Source& s=t.source[handlerSource[i]];
+      add(s.count,s.maxTicks,s.sumTicks,ticks);
+      return;
+    }
+    t.unknown++;
+  };
+  /** Called by DirectTaskManager when a task on a match channel fires
+  \param ch     match channel
+  \param ticks  timer count when the task started, minus its match value */
+  void fired(unsigned int ch, uint32_t ticks) {
+    if(ch>=nChannels) return;
+    Late& l=t.late[ch];
+    add(l.count,l.maxTicks,l.sumTicks,ticks);
+  };
+  /** Copy the table and start it over, as one atomic step */
+  void snapshot(Table& out) {
+    uint32_t cpsr=irq_save();
+    out=t;
+    clear();
+    irq_restore(cpsr);
+  };
+};
+
+inline IrqStats irqStats;
+
+#endif
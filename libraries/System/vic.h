@@ -2,6 +2,9 @@
 #define VIC_H
 
 #include "irq.h"
+#ifdef IRQ_STATS
+#include "irqstats.h"
+#endif
 
 extern "C" {
 void IRQ_Wrapper();
@@ -83,6 +86,9 @@ public:
       if ( VICVectAddrSlot(i) == nullptr ) {
         VICVectAddrSlot(i) = HandlerAddr;    // set interrupt vector 
         VICVectCntlSlot(i) = (IRQ_SLOT_EN | IntNumber);
+#ifdef IRQ_STATS
+        irqStats.installed(IntNumber,HandlerAddr);
+#endif
         VICIntEnable() |= 1 << IntNumber;  // Enable Interrupt 
         return true;
       }
@@ -150,7 +156,14 @@ inline VICDriver VIC;
 void __attribute__ ((interrupt("IRQ"),weak)) IRQ_Wrapper() {
   // Now we see why we like high-level languages for IRQ handling. It says treat
   // the number as a pointer to a function and call it.
+#ifdef IRQ_STATS
+  uint32_t tc0=irqStats.now();
+  fvoid h=VIC.VICVectAddr();
+  h();
+  irqStats.dispatched(h,tc0);
+#else
   VIC.VICVectAddr()();
+#endif
   // ACK the VIC
   VIC.VICVectAddr()=nullptr;
 };
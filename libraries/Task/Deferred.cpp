@@ -0,0 +1,85 @@
+#include "Deferred.h"
+#include "LPC214x.h"
+#include "irq.h"
+#include "dtc.h"
+
+DeferredQueue deferredQueue(0);
+
+/**Post a work item to be run later from the main loop
+\param priority Priority level, 0 is highest
+\param f        work function to run
+\param stuff    "Stuff" pointer passed to the work function
+\return true if the item is waiting to be run, false if the level was full and
+        the item was thrown away.
+
+If the same function and stuff pointer is already waiting at this priority, it
+isn't posted again. The waiting item will do the work that both would have done.
+*/
+bool DeferredQueue::post(int priority, taskfunc f, void* stuff) {
+  uint32_t tc=TTC(timer);
+  Level& l=level[priority];
+  uint32_t cpsr=irq_save();
+  for(uint32_t i=l.tail;i!=l.head;i++) {
+    DeferredWork& w=l.slot[i%DEFERRED_DEPTH];
+    if(w.f==f && w.stuff==stuff) {
+      l.coalesced++;
+      irq_restore(cpsr);
+      return true;
+    }
+  }
+  uint32_t waiting=l.head-l.tail;
+  if(waiting>=DEFERRED_DEPTH) {
+    l.overflow++;
+    irq_restore(cpsr);
+    return false;
+  }
+  DeferredWork& w=l.slot[l.head%DEFERRED_DEPTH];
+  w.f=f;
+  w.stuff=stuff;
+  w.tc=tc;
+  //Only publish the item after it is completely written
+  l.head=l.head+1;
+  if(waiting+1>l.maxDepth) l.maxDepth=waiting+1;
+  irq_restore(cpsr);
+  return true;
+}
+
+/**Run the highest priority work item waiting, if any.
+\return true if an item was run, false if nothing was waiting
+*/
+bool DeferredQueue::run() {
+  for(int p=0;p<DEFERRED_LEVELS;p++) {
+    Level& l=level[p];
+    if(l.tail==l.head) continue;
+    //Copy the item out, so that its slot may be reused as soon as we bump the tail
+    DeferredWork w=l.slot[l.tail%DEFERRED_DEPTH];
+    l.tail=l.tail+1;
+    uint32_t tc0=TTC(timer);
+    uint32_t wait=dtc(w.tc,tc0,timer);
+    if(wait>l.maxWait) l.maxWait=wait;
+    uint32_t oldTC=currentTC;
+    currentTC=w.tc;
+    w.f(w.stuff);
+    currentTC=oldTC;
+    uint32_t runTime=dtc(tc0,TTC(timer),timer);
+    if(runTime>l.maxRun) l.maxRun=runTime;
+    return true;
+  }
+  return false;
+}
+
+bool DeferredQueue::isEmpty() {
+  for(int p=0;p<DEFERRED_LEVELS;p++) if(level[p].tail!=level[p].head) return false;
+  return true;
+}
+
+void DeferredQueue::resetStats() {
+  for(int p=0;p<DEFERRED_LEVELS;p++) {
+    Level& l=level[p];
+    l.overflow=0;
+    l.coalesced=0;
+    l.maxWait=0;
+    l.maxRun=0;
+    l.maxDepth=0;
+  }
+}
@@ -0,0 +1,76 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <inttypes.h>
+
+/* Deferred work (bottom half) queue. Interrupt handlers should do as little as
+possible -- ideally just note the time and post a work item here. The main loop
+then calls run() or runAll(), which calls the work items with interrupts
+enabled, highest priority first. Lower priority number means higher priority,
+the same as VIC slots.
+
+Each priority level is a single-producer, single-consumer ring. The consumer
+(the main loop) never disables interrupts. Producers are normally interrupt
+handlers, which the VIC never nests, so post() only briefly masks IRQs to make
+it safe to call from the main loop as well.
+
+Each level also keeps worst-case statistics, so that we can see how long work
+actually waits for the main loop to get around to it.
+
+Queue sizes are fixed at compile time, and may be changed in the program
+Makefile like this:
+
+CDEFS += -DDEFERRED_LEVELS=2 -DDEFERRED_DEPTH=16
+*/
+#ifndef DEFERRED_LEVELS
+#define DEFERRED_LEVELS 4
+#endif
+#ifndef DEFERRED_DEPTH
+#define DEFERRED_DEPTH 8 ///< Must be a power of 2
+#endif
+
+typedef void (*taskfunc)(void*);
+
+class DeferredWork {
+public:
+  taskfunc f;
+  void* stuff;
+  uint32_t tc; ///< Timer count when this item was posted
+};
+
+class DeferredQueue {
+private:
+  struct Level {
+    DeferredWork slot[DEFERRED_DEPTH];
+    volatile uint32_t head; ///< Count of items ever posted, only written by post()
+    volatile uint32_t tail; ///< Count of items ever run, only written by run()
+    uint32_t overflow;      ///< Number of items thrown away because the level was full
+    uint32_t coalesced;     ///< Number of items not posted because an identical one was already waiting
+    uint32_t maxWait;       ///< Most ticks any item waited between post() and starting to run
+    uint32_t maxRun;        ///< Most ticks any item took to run
+    uint32_t maxDepth;      ///< Most items waiting at once
+  };
+  Level level[DEFERRED_LEVELS];
+  int timer;
+  uint32_t currentTC;
+public:
+  DeferredQueue(int Ltimer):timer(Ltimer),currentTC(0) {};
+  static const int levels=DEFERRED_LEVELS;
+  static const int depth=DEFERRED_DEPTH;
+  bool post(int priority, taskfunc f, void* stuff);
+  bool run();
+  void runAll() {while(run());};
+  bool isEmpty();
+  /** Timer count when the work item currently being run was posted. Only
+      meaningful inside a work item. */
+  uint32_t postedTC() {return currentTC;};
+  uint32_t getOverflow (int priority) {return level[priority].overflow;};
+  uint32_t getCoalesced(int priority) {return level[priority].coalesced;};
+  uint32_t getMaxWait  (int priority) {return level[priority].maxWait;};
+  uint32_t getMaxRun   (int priority) {return level[priority].maxRun;};
+  uint32_t getMaxDepth (int priority) {return level[priority].maxDepth;};
+  void resetStats();
+};
+
+extern DeferredQueue deferredQueue;
+#endif
@@ -1,7 +1,9 @@
 #include "DirectTask.h"
+#include "Deferred.h"
 #include "Time.h"
 #include "LPC214x.h"
 #include "vic.h"
+#include "dtc.h"
 #include "gpio.h"
 #ifdef DEBUG
 #include "Serial.h"
@@ -32,11 +34,24 @@ void DirectTaskManager::handleTimerISR() {
 void DirectTaskManager::handle() {
 //  flicker();
   unsigned int tir_in=TIR(timer);
+#ifdef IRQ_STATS
+  uint32_t tc=TTC(timer);
+#endif
   for(unsigned int i=1;i<4;i++) if(tir_in&TIR_MR(i)) {
     taskfunc f=taskList[i].f;
     //De-schedule the task
     taskList[i].f=0;
-    if(f!=0) f(taskList[i].stuff);
+    if(f==0) continue;
+#ifdef IRQ_STATS
+    //How late this started compared to when it was due
+    uint32_t due=TMR(timer,i);
+    irqStats.fired(i,dtc(due,tc,timer));
+#endif
+    if(deferPriority[i]>=0) {
+      deferredQueue.post(deferPriority[i],f,taskList[i].stuff);
+    } else {
+      f(taskList[i].stuff);
+    }
   }
   TIR(timer)=tir_in;
 }
@@ -65,10 +80,13 @@ int DirectTaskManager::scheduleCore(unsigned int channel, unsigned int ticks, ta
   Serial.print(",base=");Serial.print(base,DEC);
   Serial.println(")");
 #endif
+  unsigned int period=TMR0(timer)+1;
+  if(ticks>=period) return -1;
   taskList[channel].f=f;
   taskList[channel].stuff=stuff;
-  //set the match value. 
-  TMR(timer,channel)=(base+ticks)%(TMR0(timer)+1);
+  //set the match value, wrapped to the timer period without overflowing 32 bits,
+  //the same as TaskManager::add()
+  TMR(timer,channel)=(ticks>=period-base)?base-(period-ticks):base+ticks;
   //Don't reset or stop the timer on match
   TMCR(timer)&=~(6<<(channel*3));
   //Interrupt on match
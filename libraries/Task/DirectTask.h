@@ -23,6 +23,7 @@ private:
   DirectTask taskList[4]; //Allocate one for match channel 0 even though we can't use it.
                  //If we ever need more tasks, we will attach this to timer 1
                  //and perhaps PWM.
+  int deferPriority[4]; //Priority in deferredQueue to post each channel's task to, or -1 to run it in the ISR
   int timer;
   static void handleTimerISR();
   void handle();
@@ -30,8 +31,12 @@ private:
   int schedule(unsigned int ch, unsigned int ticks, taskfunc f, void* stuff);
   int reschedule(unsigned int ch, unsigned int ticks, taskfunc f, void* stuff);
 public:
-  DirectTaskManager(int Ltimer):timer(Ltimer) {};
+  DirectTaskManager(int Ltimer):deferPriority{-1,-1,-1,-1},timer(Ltimer) {};
   void begin();
+  //Tasks on this channel will be posted to deferredQueue at this priority when
+  //they come due, rather than run inside the timer interrupt. Pass -1 to run
+  //them in the interrupt again.
+  void defer(unsigned int ch, int priority) {deferPriority[ch]=priority;};
 //input:
 //  ticks - how many ticks from now to fire this task
 //  f     - task function to run
@@ -77,6 +77,24 @@ public:
   pqnode<priority,T>& peek() {
     return pqueue[1];
   }
+  //Remove an arbitrary node. Positions are 1-based, as in at() below. The
+  //last node is moved into the hole, then moved up or down as needed.
+  bool remove(position pos) {
+    if(pos<1 || pos>pqsize) return false;
+    pqueue[pos]=pqueue[pqsize];
+    pqsize--;
+    if(pos>pqsize) return true;
+    siftup(pos);
+    siftdown(pos,pqsize);
+    return true;
+  };
+  //Look at any node in the heap, in no particular order. Positions run from
+  //1 to size() inclusive.
+  pqnode<priority,T>& at(position pos) {
+    return pqueue[pos];
+  }
+  position size() {return pqsize;};
+  static const int capacity=S;
   void clear() {pqsize=0;};
 };
 
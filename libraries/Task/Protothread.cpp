@@ -0,0 +1,45 @@
+#include "Protothread.h"
+#include "Time.h"
+#include "LPC214x.h"
+#include "dtc.h"
+
+ProtothreadScheduler protothreads(0);
+
+void Protothread::sleep(unsigned int ms, unsigned int ticks) {
+  sleepStart=protothreads.now();
+  sleepTicks=ms*(Time::PCLK/1000)+ticks;
+  sleeping=true;
+}
+
+uint32_t ProtothreadScheduler::now() {
+  return TTC(timer);
+}
+
+/**Add a thread to the list run by runAll()
+\return true if the thread was added, false if the list is full
+*/
+bool ProtothreadScheduler::add(Protothread& t) {
+  if(nThreads>=PROTOTHREAD_MAX) return false;
+  thread[nThreads]=&t;
+  nThreads++;
+  return true;
+}
+
+/**Give each thread one chance to run, skipping those which are still delayed.
+Call this every time around the main loop.
+*/
+void ProtothreadScheduler::runAll() {
+  for(int i=0;i<nThreads;i++) {
+    Protothread* t=thread[i];
+    if(t->sleeping) {
+      if(dtc(t->sleepStart,TTC(timer),timer)<t->sleepTicks) continue;
+      t->sleeping=false;
+    }
+    if(t->run()==Protothread::PT_ENDED) {
+      //Don't start over from the top until someone calls restart()
+      t->sleeping=true;
+      t->sleepStart=now();
+      t->sleepTicks=0xFFFFFFFF;
+    }
+  }
+}
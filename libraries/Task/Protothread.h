@@ -0,0 +1,79 @@
+#ifndef PROTOTHREAD_H
+#define PROTOTHREAD_H
+
+#include <inttypes.h>
+
+/* Stackless cooperative threads, in the style of Adam Dunkels' protothreads.
+A multi-step device operation can be written as straight-line code, with waits
+in the middle, instead of as a chain of callbacks:
+
+  char BMP180::run() {
+    PT_BEGIN();
+    startTemperature();
+    PT_DELAY(5,0);
+    readTemperature();
+    ...
+    PT_END();
+  }
+
+Each thread is an object with its own run() method. Its whole saved state is the
+line number it is waiting at plus whatever member variables it uses, so there
+is no stack per thread and nothing is allocated. The price is that ordinary
+local variables in run() do NOT survive a wait -- anything needed after a
+PT_DELAY, PT_YIELD or PT_WAIT_UNTIL has to be a member. Also, the PT_ macros
+expand into a switch statement on __LINE__, so run() may not use switch itself
+across a wait, and there can be at most one wait on any one line.
+
+Threads are run from the main loop by ProtothreadScheduler::runAll(), never
+from an interrupt. A thread which is delayed isn't called at all until its time
+has passed, so many threads waiting on sensor conversions cost nearly nothing
+and their waits all overlap.
+*/
+
+class Protothread {
+protected:
+  unsigned short lc; ///< Local continuation -- line number to resume at, 0 to start from the top
+  bool sleeping;
+  uint32_t sleepStart;
+  uint32_t sleepTicks;
+  void sleep(unsigned int ms, unsigned int ticks);
+public:
+  static const char PT_WAITING=0; ///< Thread is blocked waiting for a condition or a delay
+  static const char PT_YIELDED=1; ///< Thread gave up the processor but wants to run again as soon as possible
+  static const char PT_ENDED  =2; ///< Thread ran off the end of PT_END and won't run again until restart()
+  Protothread():lc(0),sleeping(false),sleepStart(0),sleepTicks(0) {};
+  virtual char run()=0;
+  void restart() {lc=0;sleeping=false;};
+  friend class ProtothreadScheduler;
+};
+
+#define PT_BEGIN() switch(lc) { case 0:
+#define PT_END() } lc=0; return PT_ENDED
+//Return to the scheduler, and continue from here next time around the loop
+#define PT_YIELD() do { lc=__LINE__; return PT_YIELDED; case __LINE__:; } while(0)
+//Return to the scheduler until the condition is true. The condition is checked
+//every time around the loop, so it should be cheap.
+#define PT_WAIT_UNTIL(cond) do { lc=__LINE__; case __LINE__: if(!(cond)) return PT_WAITING; } while(0)
+//Return to the scheduler and don't come back for at least this many
+//milliseconds plus ticks.
+#define PT_DELAY(ms,ticks) do { sleep((ms),(ticks)); lc=__LINE__; return PT_WAITING; case __LINE__:; } while(0)
+
+#ifndef PROTOTHREAD_MAX
+#define PROTOTHREAD_MAX 8
+#endif
+
+class ProtothreadScheduler {
+private:
+  Protothread* thread[PROTOTHREAD_MAX];
+  int nThreads;
+  int timer;
+public:
+  ProtothreadScheduler(int Ltimer):nThreads(0),timer(Ltimer) {};
+  bool add(Protothread& t);
+  void runAll();
+  uint32_t now();
+};
+
+extern ProtothreadScheduler protothreads;
+
+#endif
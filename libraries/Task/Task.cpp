@@ -3,69 +3,60 @@
 #include "LPC214x.h"
 #include "vic.h"
 
-TaskManager taskManager;
+TaskManager taskManager(0,1);
 
-static const int TIR_MR0=(1<<0);
-static const int TIR_MR1=(1<<1);
-static const int TIR_MR2=(1<<2);
-static const int TIR_MR3=(1<<3);
-static const int TIR_CR0=(1<<4);
-static const int TIR_CR1=(1<<5);
-static const int TIR_CR2=(1<<6);
-static const int TIR_CR3=(1<<7);
+#define TIR_MR(i) (1<<(i))
 
 void TaskManager::begin() {
-  //Monopolize the timer's match channel 1 and interrupt
+  timerPeriod=TMR0(timer)+1;
+  ref=TTC(timer);
+  //Share the timer's interrupt with nothing else
   VIC.install(VIC.TIMER0+timer,handleTimerISR);
-  TMCR(timer) |= (1 << 3);     // On MR1, int but no reset
+  //On match, int but no reset or stop
+  TMCR(timer)=(TMCR(timer) & ~(7<<(channel*3))) | (1<<(channel*3));
 }
 
 void TaskManager::handleTimerISR() {
   taskManager.handle();
-  //ACK the timer
-  TIR(timer)=TIR_MR1;
-  //ACK the VIC
-  VICVectAddr=0;
-}
-
-//Check if time x is in between limits a and b
-//accounts for "around the corner" case where b is off
-//the end of the second and therefore less than a
-inline bool between(unsigned int a,unsigned int x,unsigned int b) {
-  if(a<b) {
-    //Normal case - a is less than b
-    return (x>=a) & (x<b);
-  } else {
-    //Around the corner case
-    return (x>=a) | (x<b);
-  }
 }
 
 void TaskManager::handle() {
-  if(empty()) return; //If no tasks are pending, return immediately
+  //ACK the timer first, so that a match which happens while we are running
+  //tasks gets its own interrupt rather than being lost
+  TIR(timer)=TIR_MR(channel);
   //I saw a nasty bug where two tasks ended up scheduled within ~500
   //ticks of eachother, about 10 us. The first task took longer than
-  //10us to execute, so by the time the second task was queued, it 
+  //10us to execute, so by the time the second task was queued, it
   //had already expired and was effectively pushed into the future
   //by exactly 1 second. Since the first task rescheduled itself
   //exactly twice per second, it always came first and the second
   //task never got to run.
-  //To fix this, put the task caller into a loop. Always do the first
-  //one, then keep doing tasks until either the list is empty or the
-  //next task is in the future.
-  unsigned int old_freeze_tc=freeze_tc;
-  freeze_tc=TMR1(timer);
-  do {
-    taskfunc f=peek().elt.f; 
-    void* stuff=peek().elt.stuff;
+  //To fix this, keep running tasks until either the list is empty or the
+  //next task is in the future. Deadlines are compared by their distance
+  //from ref, which only ever advances to the deadline just run, so a task
+  //which is already late still sorts before one that isn't.
+  for(;;) {
+    if(empty()) return;
+    unsigned int due=peek().pty;
+    if(offset(due)>offset(TTC(timer))) {
+      TMR(timer,channel)=due;
+      //If the deadline slipped past while we were setting the match register,
+      //it will never match, so go around again and run it now.
+      if(offset(due)>offset(TTC(timer))) return;
+      continue;
+    }
+    Task t=peek().elt;
     pop(); //Get rid of this task
-    f(stuff); //Call the task
-    //So that if we loop again and the next task reschedules, it does so off
-    //its own scheduled time, not the first scheduled time.
-    if(!empty()) TMR1(timer)=peek().pty; 
-    //Condition below: While there is a task, and it is between the time the last task int fired and now
-  } while(!empty() && between(freeze_tc,peek().pty,TTC(timer)));
-  freeze_tc=old_freeze_tc;
+    ref=due;
+    current=due;
+    unsigned int late=offset(TTC(timer));
+    if(late>maxLate) maxLate=late;
+    //Put periodic tasks back before running them, with the new deadline
+    //based on the old deadline rather than the time it actually ran, so that
+    //they don't drift.
+    if(t.period>0) push(t,add(due,t.period));
+    t.f(t.stuff); //Call the task
+  }
 }
 
 /**Schedule a task to fire a given number of ticks from when
@@ -82,55 +73,106 @@ schedule is called
     -3: Task list is full
 */
 int TaskManager::schedule(unsigned int ticks, taskfunc f, void* stuff) {
-  if(ticks>timerInterval) return -1;
-  if(ticks+freeze_tc<freeze_tc) return -1;
-  unsigned int old_freeze_tc=freeze_tc;
-  freeze_tc=TTC(timer);
-  int result=scheduleCore(TTC(timer)+ticks,f,stuff);
-  freeze_tc=old_freeze_tc;
+  uint32_t cpsr=irq_save();
+  unsigned int now=TTC(timer);
+  //Move the reference point up as far as possible without passing any
+  //pending deadline. This doesn't change the order of anything in the heap,
+  //but gives as much room as possible before the new deadline wraps past it.
+  if(empty() || offset(now)<offset(peek().pty)) {
+    ref=now;
+  } else {
+    ref=peek().pty;
+  }
+  int result=scheduleCore(now,ticks,f,stuff,0);
+  irq_restore(cpsr);
   return result;
 }
 
 //Schedule a task a at given number of milliseconds and ticks
 int TaskManager::schedule(unsigned int ms, unsigned int ticks, taskfunc f, void* stuff) {
-  return schedule(ms*(PCLK/1000)+ticks,f,stuff);
+  return schedule(ms*(Time::PCLK/1000)+ticks,f,stuff);
 }
 
 //Schedule a task to fire a given number of ticks from when the
-//last task fired. Must be used inside of a task to accurately
+//last task was supposed to fire. Must be used inside of a task to accurately
 //reschedule itself.
 int TaskManager::reschedule(unsigned int ticks, taskfunc f, void* stuff) {
-  if(ticks>timerInterval) return -1;
-  if(ticks+freeze_tc<freeze_tc) return -1;
-  unsigned int old_freeze_tc=freeze_tc;
-  freeze_tc=TMR1(timer);
-  int result=scheduleCore(TMR1(timer)+ticks,f,stuff);
-  freeze_tc=old_freeze_tc;
+  uint32_t cpsr=irq_save();
+  int result=scheduleCore(current,ticks,f,stuff,0);
+  irq_restore(cpsr);
   return result;
 }
 
 //Reschedule a task a given number of milliseconds and ticks
 int TaskManager::reschedule(unsigned int ms, unsigned int ticks, taskfunc f, void* stuff) {
-  return reschedule(ms*(PCLK/1000)+ticks,f,stuff);
+  return reschedule(ms*(Time::PCLK/1000)+ticks,f,stuff);
 }
 
-int TaskManager::scheduleCore(unsigned int ticks, taskfunc f, void* stuff) {
+/**Schedule a task to fire every so many milliseconds and ticks, first at that
+long from now. Each deadline is counted from the previous deadline, not from when
+the task actually ran, so the task doesn't drift even if it is sometimes late.
+The task keeps running until cancel() is called on it.
+*/
+int TaskManager::schedulePeriodic(unsigned int ms, unsigned int ticks, taskfunc f, void* stuff) {
+  unsigned int period=ms*(Time::PCLK/1000)+ticks;
+  if(period==0) return -2;
+  uint32_t cpsr=irq_save();
+  unsigned int now=TTC(timer);
+  if(empty() || offset(now)<offset(peek().pty)) {
+    ref=now;
+  } else {
+    ref=peek().pty;
+  }
+  int result=scheduleCore(now,period,f,stuff,period);
+  irq_restore(cpsr);
+  return result;
+}
+
+/**Remove all pending tasks with this function and stuff pointer
+\return number of tasks removed
+*/
+int TaskManager::cancel(taskfunc f, void* stuff) {
+  uint32_t cpsr=irq_save();
+  int result=0;
+  position i=1;
+  while(i<=size()) {
+    if(at(i).elt.f==f && at(i).elt.stuff==stuff) {
+      remove(i);
+      result++;
+      //Removing can shuffle an unchecked node to before i, so start over
+      i=1;
+    } else {
+      i++;
+    }
+  }
+  if(!empty()) TMR(timer,channel)=peek().pty;
+  irq_restore(cpsr);
+  return result;
+}
+
+int TaskManager::scheduleCore(unsigned int base, unsigned int ticks, taskfunc f, void* stuff, unsigned int period) {
   if(full()) return -3;
-  if(ticks>timerInterval) ticks-=timerInterval;
-  push(Task(f,stuff),ticks);
+  if(ticks>=timerPeriod) return -1;
+  unsigned int due=add(base,ticks);
+  //The new deadline has to be reachable from ref without going all the way around
+  if(offset(base)+ticks>=timerPeriod) return -1;
+  push(Task(f,stuff,period),due);
   //First unsigned int is first, whether new or old. Use it to set the MR, doesn't
   //matter if it is the same MR as before.
-  TMR1(timer)=peek().pty;
+  TMR(timer,channel)=peek().pty;
+  //If the earliest deadline was so near that it already passed, the match will
+  //never happen until the timer comes around again. Set the match for just
+  //after now instead, and let the handler run everything which is late.
+  if(offset(peek().pty)<=offset(TTC(timer))) TMR(timer,channel)=add(TTC(timer),nearTicks);
   //Really? That's it? Heaps rock!
   return 0;
 }
 
 int TaskManager::compare(unsigned int a, unsigned int b) {
-  if(a<freeze_tc) a+=timerInterval;
-  if(b<freeze_tc) b+=timerInterval;
+  a=offset(a);
+  b=offset(b);
   if(a<b) return -1;
   if(a==b) return 0;
   /*if(a>b)*/ return 1;
 }
 
-
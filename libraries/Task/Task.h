@@ -3,30 +3,57 @@
 
 #include "Heap.h"
 
-//Heaps are ideally suited for priority queues, especially since this 
-//implementation uses no pointers or dynamic memory management, unusual for 
+//Heaps are ideally suited for priority queues, especially since this
+//implementation uses no pointers or dynamic memory management, unusual for
 //advanced data structures.
 
+/* Task manager with any number of tasks sharing a single timer match channel.
+The pending tasks are kept in a heap ordered by deadline, and the match register
+is always programmed with the earliest deadline, so scheduling and dispatching
+are both O(log n) in the number of pending tasks. The timer is expected to be set
+up as normal, with match 0 resetting the counter, so that deadlines wrap around
+at TMR0+1 ticks. Since this monopolizes the timer interrupt, don't link this and
+DirectTask.cpp into the same program.
+
+The number of tasks which may be pending at once is fixed at compile time. The
+default may be changed in the program Makefile like this:
+
+CDEFS += -DTASKMANAGER_SIZE=32
+*/
+#ifndef TASKMANAGER_SIZE
+#define TASKMANAGER_SIZE 16
+#endif
+
 typedef void (*taskfunc)(void*);
 
 class Task {
 public:
-  Task(taskfunc Lf,void* Lstuff):f(Lf),stuff(Lstuff) {};
-  Task():f((taskfunc)0),stuff((void*)0) {};
+  Task(taskfunc Lf,void* Lstuff,unsigned int Lperiod=0):f(Lf),stuff(Lstuff),period(Lperiod) {};
+  Task():f((taskfunc)0),stuff((void*)0),period(0) {};
   taskfunc f;
   void* stuff;
+  unsigned int period; ///< If nonzero, the task is put back in the queue this many ticks after its own deadline each time it runs
 };
 
-class TaskManager: public Heap<unsigned int, Task, 7> {
+class TaskManager: public Heap<unsigned int, Task, TASKMANAGER_SIZE> {
 private:
-  static const int timer=0;
+  int timer;
+  int channel;
+  unsigned int timerPeriod; ///< Number of ticks before the timer wraps, TMR0+1
+  unsigned int ref;         ///< All pending deadlines are at or after this time, and are ordered by their distance from it
+  unsigned int current;     ///< Deadline of the task being run right now, used as the base by reschedule()
+  unsigned int maxLate;     ///< Greatest number of ticks between a deadline and the actual start of its task
+  static const unsigned int nearTicks=100; ///< Far enough in the future that the match register can be set before the timer gets there
   static void handleTimerISR();
   void handle();
-  int scheduleCore(unsigned int ticks, taskfunc f, void* stuff);
-  unsigned int freeze_tc;
-  virtual int compare(unsigned int a, unsigned int b);
+  int scheduleCore(unsigned int base, unsigned int ticks, taskfunc f, void* stuff, unsigned int period);
+  //Number of ticks from ref to x, going forward around the corner if needed
+  unsigned int offset(unsigned int x) {return (x>=ref)?x-ref:x+(timerPeriod-ref);};
+  //Time ticks after a, wrapped to the timer period without overflowing 32 bits
+  unsigned int add(unsigned int a, unsigned int ticks) {return (ticks>=timerPeriod-a)?a-(timerPeriod-ticks):a+ticks;};
+  int compare(unsigned int a, unsigned int b) override;
 public:
-  TaskManager() {};
+  TaskManager(int Ltimer, int Lchannel):timer(Ltimer),channel(Lchannel),timerPeriod(0),ref(0),current(0),maxLate(0) {};
   void begin();
 //input:
 //  ticks - how many ticks from now to fire this task
@@ -43,6 +70,10 @@ public:
   int reschedule(unsigned int ticks, taskfunc f, void* stuff);
   int schedule(unsigned int ms, unsigned int ticks, taskfunc f, void* stuff);
   int reschedule(unsigned int ms, unsigned int ticks, taskfunc f, void* stuff);
+  int schedulePeriodic(unsigned int ms, unsigned int ticks, taskfunc f, void* stuff);
+  int cancel(taskfunc f, void* stuff);
+  unsigned int getMaxLate() {return maxLate;};
+  void resetMaxLate() {maxLate=0;};
 };
 
 extern TaskManager taskManager;
@@ -4,7 +4,7 @@
 
 #undef BMP180_DEBUG 
 
-BMP180::BMP180(TwoWire &Lport):port(Lport),OSS(3) {}
+BMP180::BMP180(TwoWire &Lport):port(Lport),OSS(3),timer_ch(0) {}
 
 // Stores all of the bmp085's calibration values into global variables
 // Calibration values are required to calculate temp and pressure
@@ -171,6 +171,12 @@ void BMP180::startMeasurementCore() {
 }
 
 void BMP180::startMeasurement() {
+  if(timer_ch==0) {
+    //The protothread notices this next time around the loop and does the rest
+    ready=false;
+    start=true;
+    return;
+  }
   startMeasurementCore();
   start=true;
   ready=false;
@@ -227,6 +233,23 @@ void BMP180::finishPres() {
   start=false;
 }
 
+//The same sequence as startMeasurement(), finishTemp() and finishPres(), with
+//the conversion waits spent back in the main loop rather than on timer tasks.
+char BMP180::run() {
+  PT_BEGIN();
+  for(;;) {
+    PT_WAIT_UNTIL(start);
+    startMeasurementCore();
+    PT_DELAY(5,0);
+    finishTempCore();
+    PT_DELAY(2+(3<<OSS),0);
+    finishPresCore();
+    ready=true;
+    start=false;
+  }
+  PT_END();
+}
+
 void BMP180::takeMeasurement() {
   startMeasurementCore();
   delay(5);
@@ -5,8 +5,14 @@
 #include "Wire.h"
 #include "Serial.h"
 #include "packet.h"
+#include "Protothread.h"
 
-class BMP180 {
+//The measurement sequence can either run as a chain of timer tasks on a
+//DirectTaskManager channel (begin(channel)) or as a protothread run from the
+//main loop (begin(0), then protothreads.add(bmp180)). Channel 0 is never
+//available in DirectTaskManager since match 0 resets the timer, so it is used
+//to mean "no timer channel".
+class BMP180: public Protothread {
   private:
     // Calibration values
     short  ac1;
@@ -50,7 +56,8 @@ class BMP180 {
     BMP180(TwoWire &Lport);
     BMP180(TwoWire &Lport, unsigned int Ltimer_ch):BMP180(Lport) {begin(Ltimer_ch);};
     volatile bool ready;
-    bool begin(unsigned int Ltimer_ch);
+    bool begin(unsigned int Ltimer_ch=0);
+    char run() override;
     bool readCalibration();
     void printCalibration(Stream *Louf);
     void fillCalibration(Packet& pkt);
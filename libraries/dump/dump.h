@@ -7,9 +7,53 @@ extern char btext[],etext[];
 extern char source_start[];
 extern char source_end[];
 
+/* Each line of a dump is formatted into a Line on the stack, then goes to the
+port in one bulk write (or a few, if the line is longer than the buffer). At
+9600 baud, this keeps the UART FIFO full with one call per line rather than a
+virtual write() call, and a Print::printNumber(), per character. The buffer
+size may be changed in the program Makefile like this:
+
+CDEFS += -DDUMP_LINE_BUF=160
+*/
+#ifndef DUMP_LINE_BUF
+#define DUMP_LINE_BUF 128
+#endif
+
 class Dump {
 protected:
   Print& out; 
+  static constexpr char hexDigits[17]="0123456789ABCDEF";
+  class Line {
+  private:
+    Print& out;
+    char buf[DUMP_LINE_BUF];
+    int len;
+  public:
+    Line(Print& Lout):out(Lout),len(0) {};
+    ~Line() {flush();};
+    void put(char c) {
+      if(len>=DUMP_LINE_BUF) flush();
+      buf[len++]=c;
+    };
+    void hex(unsigned char b) {
+      put(hexDigits[b>>4]);
+      put(hexDigits[b & 0x0F]);
+    };
+    //At least digits hex digits, more if n needs them
+    void hex(uint32_t n, int digits) {
+      while(digits<8 && (n>>(4*digits))!=0) digits++;
+      for(int i=digits-1;i>=0;i--) put(hexDigits[(n>>(4*i)) & 0x0F]);
+    };
+    void flush() {
+      if(len>0) out.write(buf,len);
+      len=0;
+    };
+    void endl() {
+      put('\r');
+      put('\n');
+      flush();
+    };
+  };
 public:
   int preferredLen;
   Dump(Print& Lout, int LpreferredLen):out(Lout),preferredLen(LpreferredLen) {};
@@ -33,7 +77,7 @@ public:
     end();
   }
   void region(const char* start, int len, int rec_len) {
-    region(start,(int)start,len,rec_len);
+    region(start,(int)(intptr_t)start,len,rec_len);
   }
   void region(const char* start, int len) {
     region(start,0,len,preferredLen);
@@ -83,53 +127,55 @@ class IntelHex: public Dump {
 private:
   unsigned char checksum;
   unsigned int addr;
-  void print_byte(unsigned char b) {
+  void print_byte(Line& l, unsigned char b) {
     checksum+=b;
-    out.print(b>>4,HEX);
-    out.print(b & 0x0F,HEX);
+    l.hex(b);
   }
-  void begin_line(unsigned char len, unsigned short a, unsigned char type) {
+  void begin_line(Line& l, unsigned char len, unsigned short a, unsigned char type) {
     checksum=0;
-    out.print(":");
-    print_byte(len);
-    print_byte(a>>8);
-    print_byte(a & 0xFF);
-    print_byte(type);
+    l.put(':');
+    print_byte(l,len);
+    print_byte(l,a>>8);
+    print_byte(l,a & 0xFF);
+    print_byte(l,type);
   }
-  void end_line() {
-    print_byte(256-checksum);
-    out.println();
+  void end_line(Line& l) {
+    print_byte(l,256-checksum);
+    l.endl();
   }
-  void address(int ia){
+  void address(Line& l, int ia){
     if((ia & 0xFFFF0000) != (addr & 0xFFFF0000)) {
       addr=ia;
-      begin_line(2,0,4);
-      print_byte((addr>>24) & 0xFF);
-      print_byte((addr>>16) & 0xFF);
-      end_line();
+      begin_line(l,2,0,4);
+      print_byte(l,(addr>>24) & 0xFF);
+      print_byte(l,(addr>>16) & 0xFF);
+      end_line(l);
     }
   }
 public:
   IntelHex(Print& Lout):Dump(Lout,32) {};
   void line(const char* start0, const char* start1, int base, int len0, int len1) override {
-    address(base);
-    begin_line(len0+len1,((unsigned int)base)&0xFFFF,0);
-    for(int i=0;i<len0;i++) print_byte(start0[i]);
-    for(int i=0;i<len1;i++) print_byte(start1[i]);
-    end_line();
+    Line l(out);
+    address(l,base);
+    begin_line(l,len0+len1,((unsigned int)base)&0xFFFF,0);
+    for(int i=0;i<len0;i++) print_byte(l,start0[i]);
+    for(int i=0;i<len1;i++) print_byte(l,start1[i]);
+    end_line(l);
   }
   void begin() override {
     addr=0;
   }
   void end() override{
-    begin_line(0,0,1);
-    end_line();
+    Line l(out);
+    begin_line(l,0,0,1);
+    end_line(l);
   }
   void line(const char* start, int base, int len) override {
-    address(base);
-    begin_line(len,((unsigned int)base)&0xFFFF,0);
-    for(int i=0;i<len;i++) print_byte(start[i]);
-    end_line();
+    Line l(out);
+    address(l,base);
+    begin_line(l,len,((unsigned int)base)&0xFFFF,0);
+    for(int i=0;i<len;i++) print_byte(l,start[i]);
+    end_line(l);
   }
 };
 
@@ -138,70 +184,69 @@ public:
 //will be encoded into 5n characters. 
 class Base85: public Dump {
 private:
-  void print_group(const char* p, int len) {
-    unsigned int group=0;
+  //n/85 for all 32-bit n, as a multiply by the reciprocal since divides are slow
+  //library calls on ARM7. 0xC0C0C0C1 is 2^38/85 rounded up, and the rounding
+  //error times n stays under 2^38, so this is exact.
+  static uint32_t div85(uint32_t n) {return (uint32_t)(((uint64_t)n*0xC0C0C0C1U)>>38);};
+  void print_group(Line& l, const unsigned char* p, int len) {
+    uint32_t group=0;
     for(int i=0;i<4;i++) {
       group<<=8;
       if(i<len) group |= p[i];
     }
     char group_c[5];
-    for(int i=0;i<5;i++) {
-      group_c[4-i]=(group % 85)+33;
-      group/=85;
+    for(int i=4;i>=0;i--) {
+      uint32_t q=div85(group);
+      group_c[i]=(group-q*85)+33;
+      group=q;
     }
-    for(int i=0;i<len+1;i++) out.print(group_c[i]);
+    for(int i=0;i<len+1;i++) l.put(group_c[i]);
   }
 public:
   Base85(Print& Lout):Dump(Lout,64) {}
   Base85(Print& Lout, int LpreferredLen):Dump(Lout,LpreferredLen) {}
   void line(const char* start, int base, int len) override {
+    Line l(out);
+    const unsigned char* p=(const unsigned char*)start;
     while(len>0) {
-      print_group(start,len>4?4:len);
-      start+=4;
+      print_group(l,p,len>4?4:len);
+      p+=4;
       len-=4;
     }
-    out.println();
+    l.endl();
   }
 };
 
 class Hd: public Dump {
+private:
+  static char printable(char c) {return (c>=32 && c<127)?c:'.';};
 public:
   void line(const char* start0, const char* start1, int base, int len0, int len1) override {
-    out.print(base,HEX,4);
-    out.print(' ');
+    Line l(out);
+    l.hex((uint32_t)base,4);
+    l.put(' ');
     for(int i=0;i<len0;i++) {
-      out.print(start0[i],HEX,2);
-      if(i%4==3) out.print(' ');
+      l.hex((unsigned char)start0[i]);
+      if(i%4==3) l.put(' ');
     }
     for(int i=0;i<len1;i++) {
-      out.print(start1[i],HEX,2);
-      if((i+len0)%4==3) out.print(' ');
+      l.hex((unsigned char)start1[i]);
+      if((i+len0)%4==3) l.put(' ');
     }
     for(int i=len0+len1;i<preferredLen;i++) {
-      out.print("  ");
-      if(i%4==3) out.print(' ');
+      l.put(' ');
+      l.put(' ');
+      if(i%4==3) l.put(' ');
     }
-    out.print(' ');
-    for(int i=0;i<len0;i++) out.print((start0[i]>=32 && start0[i]<127)?start0[i]:'.');
-    for(int i=0;i<len1;i++) out.print((start1[i]>=32 && start1[i]<127)?start1[i]:'.');
-    out.println();
+    l.put(' ');
+    for(int i=0;i<len0;i++) l.put(printable(start0[i]));
+    for(int i=0;i<len1;i++) l.put(printable(start1[i]));
+    l.endl();
   }
   Hd(Print& Lout):Dump(Lout,16) {}
   Hd(Print& Lout, int LpreferredLen):Dump(Lout,LpreferredLen) {}
   void line(const char* start, int base, int len) override {
-    out.print(base,HEX,4);
-    out.print(' ');
-    for(int i=0;i<len;i++) {
-      out.print(start[i],HEX,2);
-      if(i%4==3) out.print(' ');
-    }
-    for(int i=len;i<preferredLen;i++) {
-      out.print("  ");
-      if(i%4==3) out.print(' ');
-    }
-    out.print(' ');
-    for(int i=0;i<len;i++) out.print((start[i]>=32 && start[i]<127)?start[i]:'.');
-    out.println();
+    line(start,nullptr,base,len,0);
   }
 };
 
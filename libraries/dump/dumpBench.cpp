@@ -0,0 +1,120 @@
+/* Host benchmark of the dumps in dump.h. Runs Hd, IntelHex, and Base85 over a
+block of test data into a Print which only counts, and reports how fast each
+formats and how many write() calls each line takes.
+
+Usage: dumpBench [-n bytes] [-r repeats] [-o prefix]
+
+  -n  Bytes of test data, default 1048576. It is part text and part random
+      bytes, so that Hd has both kinds of character in its ASCII column.
+  -r  Times to dump the data for the timing, default 10
+  -o  Also write the test data to prefix.bin and each dump to prefix.hd.txt,
+      prefix.ihex.txt, and prefix.b85.txt, for a round trip through dumpDecode:
+
+        dumpDecode -f hd prefix.hd.bin prefix.hd.txt && cmp prefix.bin prefix.hd.bin
+
+      make dumpRoundTrip does this for all three.
+
+Besides the speed on the host, each dump reports its characters per byte of
+data, and from that how long the dump of the whole block takes at 9600 baud,
+which is what limits it on the target.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+#include "dump.h"
+
+/** Print which only counts what goes through it, and optionally copies it to a file */
+class CountingPrint: public Print {
+public:
+  uint64_t bytes;
+  uint64_t writes;
+  uint64_t lines;
+  FILE* copy;
+  CountingPrint():copy(nullptr) {reset();};
+  void reset() {bytes=0;writes=0;lines=0;};
+  void write(unsigned char c) override {
+    bytes++;writes++;
+    if(c=='\n') lines++;
+    if(copy) fputc(c,copy);
+  };
+  void write(const char* buf, size_t len) override {
+    bytes+=len;writes++;
+    const char* p=buf;
+    const char* end=buf+len;
+    while((p=(const char*)memchr(p,'\n',end-p))!=nullptr) {lines++;p++;}
+    if(copy) fwrite(buf,1,len,copy);
+  };
+  using Print::write;
+};
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+static void bench(const char* name, Dump& d, CountingPrint& out, const char* data, int len, int repeats, const char* prefix) {
+  if(prefix) {
+    char fn[256];
+    snprintf(fn,sizeof(fn),"%s.%s.txt",prefix,name);
+    out.copy=fopen(fn,"wb");
+    if(!out.copy) {perror(fn);exit(1);}
+    d.region(data,0,len,d.preferredLen);
+    fclose(out.copy);
+    out.copy=nullptr;
+  }
+  out.reset();
+  double t0=now();
+  for(int i=0;i<repeats;i++) d.region(data,0,len,d.preferredLen);
+  double t=now()-t0;
+  double in=(double)len*repeats;
+  printf("%-5s %10.1f %10.1f %8.3f %10.3f %9.1f\n",name,in/t/1e6,out.bytes/t/1e6,(double)out.bytes/in,
+         (double)out.writes/out.lines,(double)out.bytes/repeats*10/9600);
+}
+
+int main(int argc, char** argv) {
+  int len=1048576;
+  int repeats=10;
+  const char* prefix=nullptr;
+  int opt;
+  while((opt=getopt(argc,argv,"n:r:o:"))!=-1) {
+    switch(opt) {
+      case 'n': len=strtol(optarg,nullptr,0);break;
+      case 'r': repeats=strtol(optarg,nullptr,0);break;
+      case 'o': prefix=optarg;break;
+      default: len=0;break;
+    }
+  }
+  if(len<=0 || repeats<=0) {
+    fprintf(stderr,"Usage: %s [-n bytes] [-r repeats] [-o prefix]\n",argv[0]);
+    return 1;
+  }
+  char* data=(char*)malloc(len);
+  static const char text[]="The quick brown fox jumps over the lazy dog. ";
+  uint32_t x=1;
+  for(int i=0;i<len;i++) {
+    x=x*1664525+1013904223;
+    data[i]=((i/256)%2==0)?text[i%(sizeof(text)-1)]:(char)(x>>24);
+  }
+  if(prefix) {
+    char fn[256];
+    snprintf(fn,sizeof(fn),"%s.bin",prefix);
+    FILE* f=fopen(fn,"wb");
+    if(!f || fwrite(data,1,len,f)!=(size_t)len) {perror(fn);return 1;}
+    fclose(f);
+  }
+  CountingPrint out;
+  Hd hd(out);
+  IntelHex ihex(out);
+  Base85 b85(out);
+  printf("%d bytes, %d times\n",len,repeats);
+  printf("dump    in(MB/s)  out(MB/s) out/in  writes/line  s@9600\n");
+  bench("hd",  hd,  out,data,len,repeats,prefix);
+  bench("ihex",ihex,out,data,len,repeats,prefix);
+  bench("b85", b85, out,data,len,repeats,prefix);
+  free(data);
+  return 0;
+}
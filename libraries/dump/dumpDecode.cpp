@@ -0,0 +1,203 @@
+/* Host side decoder for the text dumps in dump.h, to get binary back out of a
+serial capture.
+
+Usage: dumpDecode -f hd|ihex|b85 <out.bin> <capture>...
+
+The capture may have anything else mixed in with the dump, so each format only
+takes lines which check out:
+
+  hd    Address, hex bytes in groups of four, and the ASCII column, which must
+        agree with the bytes. Each line goes at its address, less the address
+        of the first line.
+  ihex  Intel hex records with a good checksum. Data records go at their
+        address (with the upper half from the last type 4 record), less the
+        address of the first data record.
+  b85   Lines of nothing but Base85 characters (! to u), each with a length
+        that a whole number of bytes encodes to. There is nothing in a line to
+        say where it goes, so lines are just written one after the other.
+
+Exit status is 0 if anything was decoded, 2 if nothing was, and 1 on errors.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+static const int maxLine=4096;
+
+enum Format {hd,ihex,b85};
+
+static FILE* ouf;
+static bool haveOrigin=false;
+static uint32_t origin;
+static uint32_t lines,rejected,bytes;
+static uint32_t b85pos;
+static uint32_t ihexUpper;
+
+static int hexVal(char c) {
+  if(c>='0' && c<='9') return c-'0';
+  if(c>='A' && c<='F') return c-'A'+10;
+  if(c>='a' && c<='f') return c-'a'+10;
+  return -1;
+}
+
+static int hexByte(const char* p) {
+  int hi=hexVal(p[0]);
+  if(hi<0) return -1;
+  int lo=hexVal(p[1]);
+  if(lo<0) return -1;
+  return (hi<<4) | lo;
+}
+
+static void put(uint32_t addr, const uint8_t* data, int len) {
+  if(!haveOrigin) {
+    haveOrigin=true;
+    origin=addr;
+  }
+  if(addr<origin) {
+    fprintf(stderr,"Line at %08X is before the first line at %08X, skipped\n",addr,origin);
+    rejected++;
+    return;
+  }
+  if(fseek(ouf,addr-origin,SEEK_SET)!=0 || fwrite(data,1,len,ouf)!=(size_t)len) {
+    perror("write");
+    exit(1);
+  }
+  lines++;
+  bytes+=len;
+}
+
+//addr then a space, then bytes in groups of up to four, each group followed by
+//one space. A short group, or two spaces, ends the bytes. Then padding and one
+//more space, then one printable character or '.' for each byte.
+static bool decodeHd(const char* line) {
+  const char* p=line;
+  uint32_t addr=0;
+  int n=0;
+  for(;hexVal(*p)>=0;p++,n++) addr=(addr<<4) | hexVal(*p);
+  if(n<4 || n>8 || *p!=' ') return false;
+  p++;
+  uint8_t data[maxLine/2];
+  int len=0;
+  for(;;) {
+    int group=0;
+    while(group<4) {
+      int b=hexByte(p);
+      if(b<0) break;
+      data[len++]=b;
+      p+=2;
+      group++;
+    }
+    if(*p!=' ') return false;
+    p++;
+    if(group<4 || *p==' ') break;
+  }
+  if(len==0) return false;
+  while(*p==' ' && strlen(p)>(size_t)len) p++;
+  if(strlen(p)!=(size_t)len) return false;
+  for(int i=0;i<len;i++) {
+    char c=(data[i]>=32 && data[i]<127)?data[i]:'.';
+    if(p[i]!=c) return false;
+  }
+  put(addr,data,len);
+  return true;
+}
+
+static bool decodeIhex(const char* line) {
+  if(line[0]!=':') return false;
+  int n=strlen(line+1);
+  if(n<10 || n%2!=0) return false;
+  uint8_t rec[maxLine/2];
+  uint8_t sum=0;
+  for(int i=0;i<n/2;i++) {
+    int b=hexByte(line+1+2*i);
+    if(b<0) return false;
+    rec[i]=b;
+    sum+=b;
+  }
+  int len=rec[0];
+  if(sum!=0 || len+5!=n/2) return false;
+  uint32_t addr=(rec[1]<<8) | rec[2];
+  switch(rec[3]) {
+    case 0:
+      put(ihexUpper | addr,rec+4,len);
+      break;
+    case 1:
+      break;
+    case 4:
+      if(len!=2) return false;
+      ihexUpper=(rec[4]<<24) | (rec[5]<<16);
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+//Groups of five characters make four bytes. A short group of n+1 characters
+//at the end of a line makes n bytes, and is decoded as if padded with 'u'.
+static bool decodeB85(const char* line) {
+  int n=strlen(line);
+  if(n==0 || n%5==1) return false;
+  for(int i=0;i<n;i++) if(line[i]<33 || line[i]>117) return false;
+  uint8_t data[maxLine];
+  int len=0;
+  for(int i=0;i<n;i+=5) {
+    int chars=n-i<5?n-i:5;
+    uint64_t group=0;
+    for(int j=0;j<5;j++) group=group*85+(j<chars?line[i+j]-33:84);
+    if(group>0xFFFFFFFFULL) return false;
+    for(int j=0;j<chars-1;j++) data[len++]=group>>(24-8*j);
+  }
+  put(b85pos,data,len);
+  b85pos+=len;
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int opt;
+  int format=-1;
+  while((opt=getopt(argc,argv,"f:"))!=-1) {
+    switch(opt) {
+      case 'f':
+        if(strcmp(optarg,"hd")==0) format=hd;
+        else if(strcmp(optarg,"ihex")==0) format=ihex;
+        else if(strcmp(optarg,"b85")==0) format=b85;
+        break;
+      default:  argc=0;break;
+    }
+  }
+  if(argc-optind<2 || format<0) {
+    fprintf(stderr,"Usage: %s -f hd|ihex|b85 <out.bin> <capture>...\n",argv[0]);
+    return 1;
+  }
+  ouf=fopen(argv[optind],"wb");
+  if(!ouf) {
+    perror(argv[optind]);
+    return 1;
+  }
+  static char line[maxLine];
+  for(int i=optind+1;i<argc;i++) {
+    FILE* inf=fopen(argv[i],"rb");
+    if(!inf) {
+      perror(argv[i]);
+      return 1;
+    }
+    while(fgets(line,sizeof(line),inf)) {
+      //Lines end with \r\n on the serial port, but take any mix
+      line[strcspn(line,"\r\n")]=0;
+      bool ok=false;
+      switch(format) {
+        case hd:   ok=decodeHd(line);  break;
+        case ihex: ok=decodeIhex(line);break;
+        case b85:  ok=decodeB85(line); break;
+      }
+      if(!ok && line[0]!=0) rejected++;
+    }
+    fclose(inf);
+  }
+  fclose(ouf);
+  fprintf(stderr,"%u lines, %u bytes decoded, %u other lines\n",lines,bytes,rejected);
+  return lines>0?0:2;
+}
@@ -0,0 +1,244 @@
+/* Host side extraction of the source tarball which the firmware logs about
+itself, so that a log can always be matched with the code which wrote it.
+
+Usage: sourceExtract [-a apid] [-w offsetBytes] [-h hash] <out.tar.gz> <log>...
+
+Each source packet is the primary header, a big-endian offset into the
+tarball, then a piece of the tarball. Rocketometer uses apid 0x03 with a 32-bit
+offset (older Rocketometer builds used a 16-bit offset, -w 2), and
+PacketDumpTest and SensorDumpTest use apid 0x04 with a 32-bit offset (-a 4).
+
+The logs are read in one streaming pass each, in the order given, so give a
+set of rotated logs in order. Each piece is written straight to its offset in
+the output file, so nothing is held in memory but a list of which ranges have
+arrived. A piece which covers a range that has already arrived is compared
+with what was written before, and counted as a duplicate if it matches or a
+conflict if it doesn't. This way a dump which was logged more than once, or
+split across logs, comes out once.
+
+Rocketometer also logs an apid 0x1D packet at the start of each log with the
+FNV-1a hash and length of its tarball. The first hash seen, or the one given
+with -h, picks the build to extract. Source packets logged while a different
+build's hash is current are skipped. When the hash and length are known, the
+finished output is checked against them.
+
+Exit status is 0 if the tarball came out whole (and matches its hash, if
+known), 2 if there are gaps or conflicts, and 1 on errors.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <map>
+#include "packetScan.h"
+
+static const int apidSourceId=0x1D;
+
+static uint32_t get16(const uint8_t* p) {return (p[0]<<8) | p[1];}
+static uint32_t get32(const uint8_t* p) {return ((uint32_t)p[0]<<24) | ((uint32_t)p[1]<<16) | ((uint32_t)p[2]<<8) | p[3];}
+
+static int apid=0x03;
+static int offsetBytes=4;
+static bool haveHash=false;
+static uint32_t wantHash;
+static uint32_t wantLen;
+static bool haveLen=false;
+static bool currentBuild=true; ///< The last 0x1D seen, if any, is for the build being extracted
+static int outfd;
+
+//Ranges of the tarball which have arrived, start -> end
+static std::map<uint32_t,uint32_t> have;
+static uint32_t pieces,duplicates,conflicts,skipped;
+static uint32_t last16;   ///< Unwrapped offset of the last piece, for 16-bit offsets
+
+//Compare a piece with what is already in the output over [start,end)
+static bool same(const uint8_t* data, uint32_t start, uint32_t end) {
+  uint8_t old[maxPacket];
+  if(pread(outfd,old,end-start,start)!=(ssize_t)(end-start)) return false;
+  return memcmp(old,data,end-start)==0;
+}
+
+static void piece(uint32_t offset, const uint8_t* data, uint32_t len) {
+  if(len==0) return;
+  pieces++;
+  uint32_t end=offset+len;
+  //Check the new piece against every range it overlaps
+  bool dup=false,conflict=false;
+  auto it=have.upper_bound(offset);
+  if(it!=have.begin()) --it;
+  for(;it!=have.end() && it->first<end;++it) {
+    uint32_t a=it->first>offset?it->first:offset;
+    uint32_t b=it->second<end?it->second:end;
+    if(a>=b) continue;
+    dup=true;
+    if(!same(data+(a-offset),a,b)) conflict=true;
+  }
+  if(conflict) {
+    //Keep what arrived first, and say so
+    conflicts++;
+    fprintf(stderr,"Piece at offset %u, %u bytes, differs from what was already extracted\n",offset,len);
+    return;
+  }
+  if(dup) duplicates++;
+  if(pwrite(outfd,data,len,offset)!=(ssize_t)len) {
+    perror("pwrite");
+    exit(1);
+  }
+  //Merge into the list of ranges
+  uint32_t s=offset,e=end;
+  it=have.upper_bound(s);
+  if(it!=have.begin()) {
+    auto prev=it;
+    --prev;
+    if(prev->second>=s) it=prev;
+  }
+  while(it!=have.end() && it->first<=e) {
+    if(it->first<s) s=it->first;
+    if(it->second>e) e=it->second;
+    it=have.erase(it);
+  }
+  have[s]=e;
+}
+
+static void packet(const uint8_t* p, int len) {
+  int pktApid=((p[0]<<8) | p[1]) & 0x7FF;
+  bool hasTC=(p[0] & 0x08)!=0;
+  const uint8_t* d=p+(hasTC?10:6);
+  int dlen=len-(d-p);
+  if(pktApid==apidSourceId && dlen>=9) {
+    uint32_t hash=get32(d);
+    if(!haveHash) {
+      haveHash=true;
+      wantHash=hash;
+    }
+    currentBuild=(hash==wantHash);
+    if(currentBuild) {
+      wantLen=get32(d+4);
+      haveLen=true;
+    }
+    return;
+  }
+  if(pktApid!=apid || dlen<offsetBytes) return;
+  if(!currentBuild) {
+    skipped++;
+    return;
+  }
+  uint32_t offset;
+  if(offsetBytes==2) {
+    //Put back the bits the 16-bit offset lost. A dump only goes forward, so a
+    //small offset after a large one is either a wrap or a new dump from 0.
+    offset=get16(d);
+    if(offset==0) {
+      last16=0;
+    } else {
+      offset|=last16 & 0xFFFF0000;
+      if(offset<last16) offset+=0x10000;
+      last16=offset;
+    }
+  } else {
+    offset=get32(d);
+  }
+  piece(offset,d+offsetBytes,dlen-offsetBytes);
+}
+
+//Stream one log through the packet finder, a buffer at a time
+static bool readLog(const char* fn) {
+  FILE* inf=fopen(fn,"rb");
+  if(!inf) {
+    perror(fn);
+    return false;
+  }
+  //Holds at least two packets, so that we can check the header after the one we are looking at
+  static uint8_t buf[maxPacket*8];
+  int avail=0;
+  bool eof=false;
+  while(!eof || avail>=6) {
+    if(!eof) {
+      size_t got=fread(buf+avail,1,sizeof(buf)-avail,inf);
+      if(got==0) eof=true;
+      avail+=got;
+    }
+    int pos=scanPackets(buf,avail,eof,packet);
+    memmove(buf,buf+pos,avail-pos);
+    avail-=pos;
+  }
+  fclose(inf);
+  return true;
+}
+
+static uint32_t hashOutput(uint32_t len) {
+  uint32_t h=2166136261U;
+  uint8_t buf[65536];
+  uint32_t pos=0;
+  while(pos<len) {
+    uint32_t n=len-pos>sizeof(buf)?sizeof(buf):len-pos;
+    if(pread(outfd,buf,n,pos)!=(ssize_t)n) break;
+    for(uint32_t i=0;i<n;i++) {
+      h^=buf[i];
+      h*=16777619U;
+    }
+    pos+=n;
+  }
+  return h;
+}
+
+int main(int argc, char** argv) {
+  int opt;
+  while((opt=getopt(argc,argv,"a:w:h:"))!=-1) {
+    switch(opt) {
+      case 'a': apid=strtol(optarg,nullptr,0);break;
+      case 'w': offsetBytes=atoi(optarg);break;
+      case 'h': haveHash=true;wantHash=strtoul(optarg,nullptr,16);break;
+      default:  argc=0;break;
+    }
+  }
+  if(argc-optind<2 || (offsetBytes!=2 && offsetBytes!=4)) {
+    fprintf(stderr,"Usage: %s [-a apid] [-w offsetBytes] [-h hash] <out.tar.gz> <log>...\n",argv[0]);
+    return 1;
+  }
+  outfd=open(argv[optind],O_RDWR | O_CREAT | O_TRUNC,0644);
+  if(outfd<0) {
+    perror(argv[optind]);
+    return 1;
+  }
+  //The build stays current from one log to the next, since packets queued when
+  //a log is rotated land at the start of the next one
+  for(int i=optind+1;i<argc;i++) {
+    if(!readLog(argv[i])) return 1;
+  }
+  uint32_t len=haveLen?wantLen:(have.empty()?0:have.rbegin()->second);
+  if(ftruncate(outfd,len)!=0) perror("ftruncate");
+  fprintf(stderr,"%u pieces, %u duplicates, %u conflicts, %u from other builds\n",pieces,duplicates,conflicts,skipped);
+  //Report what is missing
+  uint32_t got=0,next=0;
+  int gaps=0;
+  for(auto& r:have) {
+    if(r.first>=len) break;
+    if(r.first>next) {
+      fprintf(stderr,"Missing %u-%u\n",next,r.first-1);
+      gaps++;
+    }
+    uint32_t e=r.second<len?r.second:len;
+    got+=e-r.first;
+    next=e;
+  }
+  if(next<len) {
+    fprintf(stderr,"Missing %u-%u\n",next,len-1);
+    gaps++;
+  }
+  fprintf(stderr,"%u of %u bytes%s\n",got,len,haveLen?"":" (length not logged, so taken from the last piece)");
+  bool ok=(gaps==0 && conflicts==0 && len>0);
+  if(ok && haveHash && haveLen) {
+    uint32_t h=hashOutput(len);
+    fprintf(stderr,"Hash %08X, expected %08X\n",h,wantHash);
+    if(h!=wantHash) ok=false;
+  }
+  uint8_t magic[2];
+  if(ok && pread(outfd,magic,2,0)==2 && !(magic[0]==0x1F && magic[1]==0x8B)) {
+    fprintf(stderr,"Warning: doesn't start like a gzip file\n");
+  }
+  close(outfd);
+  return ok?0:2;
+}
@@ -128,6 +128,14 @@ back to each table, and the
 assumptions made above make this valid.
 */
 bool Cluster::writeTable(uint32_t cluster, uint32_t entry) {
+  char* findbuf=sectorPool.acquire(this);
+  if(findbuf==nullptr) FAIL(20);
+  bool result=writeTable(cluster,entry,findbuf);
+  sectorPool.release(findbuf,this);
+  return result;
+}
+
+bool Cluster::writeTable(uint32_t cluster, uint32_t entry, char* findbuf) {
   if(tableEntrySize==12) FAIL(8);
   uint32_t sectorsPerTable, entrySector, entryOffset;
   calcTableCluster(cluster, sectorsPerTable, entrySector, entryOffset);
@@ -156,6 +164,14 @@ next available cluster after that, pass the number of the cluster you have just
 filled. The default value starts searching at the beginning of the table.
 */
 uint32_t Cluster::findFreeCluster(uint32_t startCluster) {
+  char* findbuf=sectorPool.acquire(this);
+  if(findbuf==nullptr) FAIL_BAD(21);
+  uint32_t result=findFreeCluster(startCluster,findbuf);
+  sectorPool.release(findbuf,this);
+  return result;
+}
+
+uint32_t Cluster::findFreeCluster(uint32_t startCluster, char* findbuf) {
   if(tableEntrySize==12) FAIL_BAD(14);
   uint32_t cluster=startCluster;
   uint32_t sectorsPerTable, entrySector, entryOffset,lastEntrySector=BAD;
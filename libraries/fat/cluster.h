@@ -4,6 +4,7 @@
 #include "Partition.h"
 #include "Print.h"
 #include "packet.h"
+#include "pool.h"
 
 /** Extended BIOS parameter block. Included separately because it could
 appear at one of two places in the block.
@@ -72,7 +73,9 @@ private:
     return ((cluster-2)*sectorsPerCluster8)+firstDataSector;
   };
   void calcTableCluster(uint32_t cluster, uint32_t& sectorsPerTable, uint32_t& entrySector, uint32_t& entryOffset);
-  char findbuf[512];
+  //Table sector buffers are borrowed from sectorPool only for the length of the call
+  bool writeTable(uint32_t cluster, uint32_t entry, char* findbuf);
+  uint32_t findFreeCluster(uint32_t startCluster, char* findbuf);
 public:
   int errno;
   Cluster(Partition &Lp):p(Lp) {};
@@ -82,8 +85,12 @@ public:
   uint32_t firstRootSector;   ///< Sector number of first sector of root directory, valid only for FAT12 and FAT16
   bool begin();
   bool read(uint32_t cluster, uint8_t sector, char* buf, int start, int len) {ASSERT(p.read(clusterFirstSector(cluster)+sector,buf,start,len),p.errno*100+1);};
-  bool read(uint32_t cluster, uint8_t sector, char* buf) {ASSERT(p.read(clusterFirstSector(cluster)+sector,buf),p.errno*100+2);};
+  bool read(uint32_t cluster, uint8_t sector, char* buf) {ASSERT(p.readUncached(clusterFirstSector(cluster)+sector,buf),p.errno*100+2);};
   bool write(uint32_t cluster, uint8_t sector, char* buf) {ASSERT(p.write(clusterFirstSector(cluster)+sector,buf,tr(1,1,1)),p.errno*100+3);};
+  bool readStart(uint32_t cluster, uint8_t sector) {ASSERT(p.readStart(clusterFirstSector(cluster)+sector),p.errno*100+4);};
+  bool readNext(char* buf) {ASSERT(p.readNext(buf),p.errno*100+5);};
+  bool readStop() {ASSERT(p.readStop(),p.errno*100+6);};
+  bool busy() {return p.busy();};
   void print(Print &out);
   uint32_t readTable(uint32_t cluster);
   bool writeTable(uint32_t cluster, uint32_t entry);
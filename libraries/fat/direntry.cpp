@@ -111,62 +111,133 @@ void DirEntry::canonFileName(const char* fn, char* canon) {
   }      
 }
 
+/** Bring a directory sector into the shared buffer, if it isn't there already.
+If the buffer holds changes to some other sector, they are written first.
+*/
+bool DirEntry::load(uint32_t cluster, uint32_t sector) {
+  if(bufFs==&f && bufCluster==cluster && bufSector==sector) return true;
+  if(buf==nullptr) {
+    buf=sectorPool.acquire(&buf);
+    if(buf==nullptr) FAIL(7);
+  }
+  if(!flush()) return false;
+  bufSector=noSector;
+  if(!f.read(cluster,sector,buf)) FAIL(f.errno*100+6);
+  bufFs=&f;
+  bufCluster=cluster;
+  bufSector=sector;
+  return true;
+}
+
+/** Load a directory entry by index, reading its sector only if it isn't already
+in buf.
+\param index index of entry from start of directory
+\return true if the entry was loaded, false if the index is past the end of the
+directory area (errno==0) or on a read error
+*/
+bool DirEntry::at(uint32_t index) {
+  errno=0;
+  if(index>=f.numRootEntries()) return false;
+  entryIndex=index;
+  entrySector=index/entriesPerSector;
+  entryOffset=(index%entriesPerSector)*32;
+  if(!load(entryCluster,entrySector)) FAIL(errno*100+1);
+  memcpy(entry,buf+entryOffset,sizeof(entry));
+  return true;
+}
+
+/** Find a file by name. When it isn't there, this has looked at every entry in
+use, so it also notes the entry findEmpty() would pick, and a findEmpty() which
+follows doesn't need to scan the directory again.
+*/
 bool DirEntry::find(const char* fn,uint32_t dir_cluster) {
   char canon[11];
   canonFileName(fn,canon);
-  uint32_t entryIndex=0;
-  entryCluster=dir_cluster;
-  bool match=false;
-  while(entryIndex<f.numRootEntries()) {
-    entrySector=entryIndex*32;
-    entryOffset=entrySector%512;
-    entrySector=entrySector/512;
-    if(!f.read(entryCluster,entrySector,entry,entryOffset,sizeof(entry))) FAIL(f.errno*100+1);
-    if(entry[0]==0) return false;
-    if(!isLFN()) {
-      int i=0;
-      match=true;
-      while((i<11)&&match) {
-        match=(canon[i]==entry[i]);
-        i++;
-      }
-      if(match) return true; 
+  uint32_t deleted=noSector;
+  freeIndex=noSector;
+  freeCluster=dir_cluster;
+  for(bool ok=first(dir_cluster);ok;ok=next()) {
+    if(entry[0]==0) {
+      freeIndex=entryIndex;
+      return false;
     }
-    entryIndex++;
+    if(deleted==noSector && (uint8_t)entry[0]==0xE5) deleted=entryIndex;
+    if(!isLFN() && memcmp(canon,shortName,sizeof(canon))==0) return true;
   }
+  if(errno==0) freeIndex=deleted;
   return false;
 }
 
+/** Find a directory entry which may be used for a new file. An entry which has
+never been used is preferred over one for a deleted file, so that deleted files
+may still be recovered as long as possible.
+*/
 bool DirEntry::findEmpty(uint32_t dir_cluster) {
-  entryCluster=dir_cluster;
-  //See if there is an unused entry first, preserve deleted entries
-  for(uint32_t entryIndex=0;entryIndex<f.numRootEntries();entryIndex++) {
-    entrySector=entryIndex*32;
-    entryOffset=entrySector%512;
-    entrySector=entrySector/512;
-    if(!f.read(entryCluster,entrySector,entry,entryOffset,sizeof(entry))) FAIL(f.errno*100+2);
+  //The entry the last find() picked out, unless another file has taken it since
+  if(freeIndex!=noSector && freeCluster==dir_cluster) {
+    uint32_t index=freeIndex;
+    freeIndex=noSector;
+    entryCluster=dir_cluster;
+    if(!at(index)) FAIL(errno*100+3);
+    if(entry[0]==0 || (uint8_t)entry[0]==0xE5) return true;
+  }
+  uint32_t deleted=noSector;
+  bool ok;
+  for(ok=first(dir_cluster);ok;ok=next()) {
     if(entry[0]==0) return true;
+    if(deleted==noSector && (uint8_t)entry[0]==0xE5) deleted=entryIndex;
   }
+  if(errno!=0) return false;
   //No unused entries, have to use a deleted entry
-  for(uint32_t entryIndex=0;entryIndex<f.numRootEntries();entryIndex++) {
-    entrySector=entryIndex*32;
-    entryOffset=entrySector%512;
-    entrySector=entrySector/512;
-    if(!f.read(entryCluster,entrySector,entry,entryOffset,sizeof(entry))) FAIL(f.errno*100+3);
-    if(entry[0]==0xE5) return true;
-  }
-  return false;
+  if(deleted==noSector) return false;
+  if(!at(deleted)) FAIL(errno*100+2);
+  return true;
 }
 
-bool DirEntry::writeBack() {
-  if(!f.read(entryCluster,entrySector,buf)) FAIL(f.errno*100+4);
-  char* pentry=(char*)&entry;
-  for(unsigned int i=0;i<sizeof(entry);i++) {
-    buf[entryOffset+i]=pentry[i];
+/** Find the highest number in use in a set of numbered filenames, in one pass
+over the directory.
+\param pattern filename with a # in place of each digit of the number, for
+instance "rkto####.sds"
+\param highest set to the highest number found, or -1 if no file matches
+\return true if the directory was scanned, false on a read error
+*/
+bool DirEntry::findHighest(const char* pattern, int& highest, uint32_t dir_cluster) {
+  char canon[11];
+  canonFileName(pattern,canon);
+  highest=-1;
+  for(bool ok=first(dir_cluster);ok;ok=next()) {
+    if(entry[0]==0) break;
+    if(isLFN() || (uint8_t)entry[0]==0xE5) continue;
+    int n=0;
+    bool match=true;
+    for(int i=0;i<11 && match;i++) {
+      if(canon[i]=='#') {
+        match=(shortName[i]>='0' && shortName[i]<='9');
+        n=n*10+(shortName[i]-'0');
+      } else {
+        match=(canon[i]==shortName[i]);
+      }
+    }
+    if(match && n>highest) highest=n;
   }
-  if(!f.write(entryCluster,entrySector,buf)) FAIL(f.errno*100+5);
-  return true;
+  return errno==0;
 }
 
-    
+/** Copy this entry into the shared directory sector buffer, without writing it
+to the card yet. This only reads the card if the buffer has since moved on to
+another sector. Call flush(), or writeBack() on any entry, to write it.
+*/
+bool DirEntry::update() {
+  if(!load(entryCluster,entrySector)) FAIL(errno*100+4);
+  memcpy(buf+entryOffset,entry,sizeof(entry));
+  bufDirty=true;
+  return true;
+}
 
+/** Write the shared directory sector buffer to the card, if it has changed */
+bool DirEntry::flush() {
+  if(!bufDirty) return true;
+  if(!bufFs->write(bufCluster,bufSector,buf)) FAIL(bufFs->errno*100+5);
+  bufDirty=false;
+  return true;
+}
@@ -4,13 +4,32 @@
 #include <inttypes.h>
 #include "Print.h"
 #include "cluster.h"
+#include "pool.h"
 
 class DirEntry {
 private:
   Cluster& f;  
-  char buf[512];
+  //All DirEntry objects share one directory sector buffer. The sector holding
+  //the entry found by the last find() or findEmpty() stays in it, so writing
+  //the entry back doesn't need to read the sector again. Since every open file
+  //patches its entry into the same buffer, it never holds a stale copy of
+  //another file's entry, and entries for several files in the same sector go
+  //out in one write. The buffer is borrowed from sectorPool the first time it
+  //is needed, and kept from then on.
+  static inline char* buf=nullptr;
+  static inline Cluster* bufFs=nullptr;
+  static inline uint32_t bufCluster=0;
+  static inline uint32_t bufSector=0xFFFFFFFF; ///< Which directory sector is in buf, noSector if none is
+  static inline bool bufDirty=false;           ///< buf has changes not yet written to the card
+  static const uint32_t noSector=0xFFFFFFFF;
+  static const int entriesPerSector=512/32;
+  uint32_t entryIndex;
+  uint32_t freeIndex;   ///< Entry for a new file which the last find() passed on the way, noSector if none
+  uint32_t freeCluster; ///< Directory that entry is in
+  bool load(uint32_t cluster, uint32_t sector);
+  bool at(uint32_t index);
 public:
-  DirEntry(Cluster& Lf):f(Lf) {};
+  DirEntry(Cluster& Lf):f(Lf),freeIndex(noSector) {};
   int errno;
   static const uint8_t ATTR_READONLY = (1<<0); 
   static const uint8_t ATTR_HIDDEN   = (1<<1); 
@@ -59,9 +78,19 @@ public:
   bool isLFN() {return (attr & (ATTR_HIDDEN|ATTR_VOLUME|ATTR_SYSTEM))==(ATTR_HIDDEN|ATTR_VOLUME|ATTR_SYSTEM);};
   void print(Print &out);
   static void canonFileName(const char* fn, char* canon);
+  //Walk the directory one entry at a time, reading each sector only once. After
+  //a successful call, the current entry is in entry and its position is in
+  //entryCluster, entrySector, and entryOffset. These return false at the end of
+  //the directory area (errno==0) or on a read error (errno!=0). The caller should
+  //stop at an entry with entry[0]==0, since no entries past that are in use.
+  bool first(uint32_t dir_cluster=0) {entryCluster=dir_cluster;return at(0);};
+  bool next() {return at(entryIndex+1);};
   bool find(const char* fn,uint32_t dir_cluster=0);
   bool findEmpty(uint32_t dir_cluster=0);
-  bool writeBack();
+  bool findHighest(const char* pattern, int& highest, uint32_t dir_cluster=0);
+  bool update();
+  bool flush();
+  bool writeBack() {if(!update()) return false;return flush();}; ///< Write this entry to the card now
 };
 
  
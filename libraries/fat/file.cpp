@@ -1,3 +1,4 @@
+#include <string.h>
 #include "file.h"
 
 bool File::openr(const char* filename,uint32_t dir_cluster) {
@@ -20,10 +21,15 @@ bool File::openw(const char* filename,uint32_t dir_cluster) {
 
 bool File::create(const char* filename,uint32_t dir_cluster) {
   if(!de.findEmpty(dir_cluster)) FAIL(100*de.errno+4);    
+  //A deleted entry still has the old file's attributes and size
+  memset(de.entry,0,sizeof(de.entry));
   de.canonFileName(filename,de.shortName);
   uint32_t cl=c.findFreeCluster(last_cluster);
   if(cl==c.BAD) FAIL(100*c.errno+5);
   de.setCluster(cl);
+  //Claim the entry in the shared directory buffer now, so that another file
+  //created before this one is written out doesn't get the same entry
+  if(!de.update()) FAIL(de.errno*100+26);
   return true;
 }
 
@@ -39,12 +45,66 @@ bool File::read(char* buf) {
   return true;
 }
 
+/** Start streaming from the current position. First follow the table from the
+current cluster for as long as the clusters are consecutive, so that the whole
+run can be read with one transfer without needing to stop and read the table in
+the middle.
+*/
+bool File::readStream(char* buf) {
+  if(!streaming) {
+    if(cluster==c.EOF) return false;
+    while(sector>=c.sectorsPerCluster()) {
+      sector-=c.sectorsPerCluster();
+      cluster=c.readTable(cluster);
+      if(cluster==c.EOF) FAIL(21);
+    }
+    uint32_t runClusters=1;
+    runNextCluster=c.readTable(cluster);
+    while(runNextCluster==cluster+runClusters && runClusters<maxRunClusters) {
+      runClusters++;
+      runNextCluster=c.readTable(runNextCluster);
+    }
+    if(runNextCluster==c.BAD) FAIL(c.errno*100+22);
+    runLeft=runClusters*c.sectorsPerCluster()-sector;
+    if(!c.readStart(cluster,sector)) FAIL(c.errno*100+23);
+    streaming=true;
+  }
+  if(!c.readNext(buf)) {
+    //SDHC::readNext() has already stopped the transfer
+    streaming=false;
+    FAIL(c.errno*100+24);
+  }
+  sector++;
+  runLeft--;
+  if(runLeft==0) {
+    if(!readStop()) return false;
+    cluster=runNextCluster;
+    sector=0;
+  }
+  return true;
+}
+
+/** Finish a streaming read. The position is kept, so read() or readStream()
+may carry on from here later. */
+bool File::readStop() {
+  if(!streaming) return true;
+  streaming=false;
+  if(!c.readStop()) FAIL(c.errno*100+25);
+  //Within a run, sector may have gone past the end of the cluster it started in.
+  //Since the run is contiguous, just move forward the same number of clusters.
+  if(runLeft>0) {
+    cluster+=sector/c.sectorsPerCluster();
+    sector%=c.sectorsPerCluster();
+  }
+  return true;
+}
+
 bool File::sync() {
   if(!de.writeBack()) FAIL(de.errno*100+8);
   return true;
 }
 
-bool File::append(char* buf) {
+bool File::append(char* buf, bool syncDir) {
 //  uint32_t write_cluster=c.BAD;
   if(de.size==0) {
     //Need to allocate first cluster
@@ -70,7 +130,11 @@ bool File::append(char* buf) {
   }
   sector++;
   de.size+=c.sectorSize();
-  if(!de.writeBack()) FAIL(de.errno*100+15);
+  if(syncDir) {
+    if(!de.writeBack()) FAIL(de.errno*100+15);
+  } else {
+    if(!de.update()) FAIL(de.errno*100+20);
+  }
   return true;
 }
 
@@ -4,19 +4,41 @@
 #include "cluster.h"
 #include "direntry.h"
 
+/** A file on a FAT filesystem. Any number of File objects may be open at once,
+say one for bulk data and one for housekeeping. A File has no sector buffer of
+its own. It reads into and appends from buffers supplied by the caller, and the
+directory and table buffers it needs come from sectorPool, so the RAM used by
+the filesystem is the same no matter how many files are open.
+*/
 class File {
   Cluster& c;
   DirEntry de;
   uint32_t cluster,sector,last_cluster;
+  bool streaming;          ///< A streaming read is open on the card
+  uint32_t runLeft;        ///< Sectors left in the contiguous run being streamed
+  uint32_t runNextCluster; ///< Cluster following the run being streamed
+  static const uint32_t maxRunClusters=16; ///< Longest run to look up in the table before starting to stream
 public:
   int errno;
-  File(Cluster& Lc):c(Lc),de(c),errno(0),last_cluster(1) {};
+  File(Cluster& Lc):c(Lc),de(c),errno(0),last_cluster(1),streaming(false) {};
   bool find(const char* fn, uint32_t dir_cluster=0) {return de.find(fn,dir_cluster);};
+  bool findHighest(const char* pattern, int& highest, uint32_t dir_cluster=0) {if(!de.findHighest(pattern,highest,dir_cluster)) FAIL(de.errno*100+20);return true;};
   bool create(const char* filename, uint32_t dir_cluster=0);
   bool openr(const char* name, uint32_t dir_cluster=0);
   bool openw(const char* name, uint32_t dir_cluster=0);
   bool read(char* buf);
-  bool append(char* buf);
+  //Same as read(), but reads each run of contiguous clusters with a single
+  //streaming transfer. The card is tied up between calls, so call readStop()
+  //before doing anything else with the card, including with other files.
+  bool readStream(char* buf);
+  bool readStop();
+  //True while the card is still programming the last block written. Any call
+  //which uses the card waits for this, so poll it first to avoid waiting.
+  bool busy() {return c.busy();};
+  //If syncDir is false, the directory entry is only updated in the shared
+  //directory sector buffer. Do this when appending to several files at once,
+  //then sync() any one of them to write all their entries which share a sector.
+  bool append(char* buf, bool syncDir=true);
   bool remove(const char* filename, char* buf,uint32_t dir_cluster=0);
   bool wipeChain();
   bool sync();
@@ -0,0 +1,30 @@
+#include "pool.h"
+
+SectorPool sectorPool;
+
+int SectorPool::indexOf(const char* b) {
+  for(int i=0;i<SECTORPOOL_SIZE;i++) if(b==buf[i]) return i;
+  return -1;
+}
+
+char* SectorPool::acquire(const void* who) {
+  if(who==nullptr) return nullptr;
+  for(int i=0;i<SECTORPOOL_SIZE;i++) {
+    if(owner[i]==nullptr) {
+      owner[i]=who;
+      used++;
+      if(used>highWater) highWater=used;
+      return buf[i];
+    }
+  }
+  failures++;
+  return nullptr;
+}
+
+bool SectorPool::release(char* b, const void* who) {
+  int i=indexOf(b);
+  if(i<0 || who==nullptr || owner[i]!=who) return false;
+  owner[i]=nullptr;
+  used--;
+  return true;
+}
@@ -0,0 +1,62 @@
+#ifndef pool_h
+#define pool_h
+
+#include <inttypes.h>
+
+/* Central pool of sector buffers for the filesystem. Rather than each object
+carrying its own 512-byte buffer, a buffer is borrowed from here when it is
+needed and given back when it isn't, so the filesystem's buffer RAM doesn't grow
+with the number of open files. It is exactly SECTORPOOL_SIZE sectors, fixed at
+compile time.
+
+Each buffer in use records its owner (any pointer the borrower likes, normally
+this), and only the owner may give it back. If the pool is empty, acquire()
+returns nullptr and the caller fails. That means the pool is too small for the
+program, so the number of failures and the most buffers ever in use at once are
+kept to help size it.
+
+Users in the filesystem:
+  DirEntry - one buffer, held for as long as the program runs, for the shared
+             directory sector (no matter how many files are open)
+  Cluster  - one buffer, borrowed while searching or writing the allocation table
+
+so the default is enough for any number of open files, provided the program
+doesn't borrow any itself. If it does, the size may be changed in the program
+Makefile like this:
+
+CDEFS += -DSECTORPOOL_SIZE=3
+*/
+#ifndef SECTORPOOL_SIZE
+#define SECTORPOOL_SIZE 2
+#endif
+
+class SectorPool {
+private:
+  char buf[SECTORPOOL_SIZE][512];
+  const void* owner[SECTORPOOL_SIZE]; ///< Owner of each buffer, nullptr if it is free
+  int used;
+  int highWater;
+  uint32_t failures;
+  int indexOf(const char* b);
+public:
+  static const int sectorSize=512;
+  static const int size=SECTORPOOL_SIZE;
+  SectorPool():used(0),highWater(0),failures(0) {for(int i=0;i<SECTORPOOL_SIZE;i++) owner[i]=nullptr;};
+  /** Borrow a buffer
+  \param who Owner to record for the buffer, must not be nullptr
+  \return buffer of sectorSize bytes, or nullptr if none are free
+  */
+  char* acquire(const void* who);
+  /** Give a buffer back
+  \return true if the buffer was given back, false if it isn't from this pool or isn't owned by who
+  */
+  bool release(char* b, const void* who);
+  const void* ownerOf(const char* b) {int i=indexOf(b);return i<0?nullptr:owner[i];};
+  int inUse()           {return used;};
+  int getHighWater()    {return highWater;};
+  uint32_t getFailures(){return failures;};
+};
+
+extern SectorPool sectorPool;
+
+#endif
@@ -0,0 +1,29 @@
+#include "fixed.h"
+
+#include "sinQ15.h"
+
+q15 sinb(uint16_t angle) {
+  unsigned int quadrant=angle>>14;
+  unsigned int x=angle & 0x3FFF;
+  //Second and fourth quadrants run backwards through the table
+  if(quadrant & 1) x=0x4000-x;
+  unsigned int i=x>>6;
+  int32_t result;
+  if(i>=256) {
+    result=sinQ15Table[256];
+  } else {
+    int32_t frac=x & 0x3F;
+    result=sinQ15Table[i]+(((sinQ15Table[i+1]-sinQ15Table[i])*frac+0x20)>>6);
+  }
+  //Third and fourth quadrants are negative
+  if(quadrant & 2) result=-result;
+  return (q15)result;
+}
+
+q31 polyq(q31 x, const q31* P, int order) {
+  q31 acc=P[order];
+  for(int i=order-1;i>=0;i--) {
+    acc=qadd(q31mul(acc,x),P[i]);
+  }
+  return acc;
+}
@@ -0,0 +1,111 @@
+#ifndef fixed_h
+#define fixed_h
+
+#include <inttypes.h>
+
+//Fixed point numbers, for when soft-float is too slow. A q15 is a number from
+//-1 to just under 1 in 16 bits, with 15 bits after the binary point. A q31 is
+//the same in 32 bits with 31 bits after the point. Everything here saturates
+//rather than wraps, so an overflow gives the nearest number that fits instead
+//of one with the wrong sign.
+typedef int16_t q15;
+typedef int32_t q31;
+
+static const q15 Q15_MAX=0x7FFF;
+static const q15 Q15_MIN=-0x8000;
+static const q31 Q31_MAX=0x7FFFFFFF;
+static const q31 Q31_MIN=-0x7FFFFFFF-1;
+
+//Convert a constant to fixed point. Evaluate these at compile time, since at
+//run time they do the float math we are trying to avoid. The limits are checked
+//after scaling and rounding, since anything from Q15_MAX+0.5 up rounds to a
+//number too big for the cast, like toQ15(0.99999), which is 32768.17.
+constexpr q15 toQ15(double x) {
+  double r=x*32768.0+(x>=0?0.5:-0.5);
+  return r>=Q15_MAX?Q15_MAX:r<=Q15_MIN?Q15_MIN:(q15)r;
+}
+constexpr q31 toQ31(double x) {
+  double r=x*2147483648.0+(x>=0?0.5:-0.5);
+  return r>=Q31_MAX?Q31_MAX:r<=Q31_MIN?Q31_MIN:(q31)r;
+}
+static inline float fromQ15(q15 x) {return x/32768.0f;}
+static inline float fromQ31(q31 x) {return x/2147483648.0f;}
+
+static inline q15 sat15(int32_t x) {
+  if(x>Q15_MAX) return Q15_MAX;
+  if(x<Q15_MIN) return Q15_MIN;
+  return (q15)x;
+}
+
+static inline q31 sat31(int64_t x) {
+  if(x>Q31_MAX) return Q31_MAX;
+  if(x<Q31_MIN) return Q31_MIN;
+  return (q31)x;
+}
+
+//Saturating add and subtract. The sum can only have overflowed if it has a
+//different sign from both of the things added.
+static inline q31 qadd(q31 a, q31 b) {
+  q31 s=(q31)((uint32_t)a+(uint32_t)b);
+  if(((a^s)&(b^s))<0) return a<0?Q31_MIN:Q31_MAX;
+  return s;
+}
+
+static inline q31 qsub(q31 a, q31 b) {
+  q31 s=(q31)((uint32_t)a-(uint32_t)b);
+  if(((a^b)&(a^s))<0) return a<0?Q31_MIN:Q31_MAX;
+  return s;
+}
+
+static inline q15 q15add(q15 a, q15 b) {return sat15((int32_t)a+b);}
+static inline q15 q15sub(q15 a, q15 b) {return sat15((int32_t)a-b);}
+
+//Rounded multiply. Only -1*-1 can overflow.
+static inline q15 q15mul(q15 a, q15 b) {return sat15(((int32_t)a*b+0x4000)>>15);}
+//The 64-bit product compiles to a single smull on ARM7TDMI
+static inline q31 q31mul(q31 a, q31 b) {return sat31(((int64_t)a*b+0x40000000)>>31);}
+
+//Multiply-accumulate. The q15 version keeps its running sum as Q30 in 32 bits,
+//so a long sum of products doesn't lose precision at each step. Use q15acc to
+//turn it back into a q15 at the end.
+static inline int32_t q15mac(int32_t acc, q15 a, q15 b) {return qadd(acc,(int32_t)a*b);}
+static inline q15 q15acc(int32_t acc) {return sat15(qadd(acc,0x4000)>>15);}
+static inline q31 q31mac(q31 acc, q31 a, q31 b) {return qadd(acc,q31mul(a,b));}
+
+//Same as trigp() and trigm() in float.h, but in q15. The products are summed as
+//Q30 before rounding, so each result is rounded only once.
+static inline void trigpq(q15 ca, q15 cb, q15 sa, q15 sb, q15 *c, q15 *s) {
+  *c=q15acc(qadd((int32_t)ca*cb,(int32_t)sa*sb));
+  *s=q15acc(qsub((int32_t)sa*cb,(int32_t)ca*sb));
+}
+
+static inline void trigmq(q15 ca, q15 cb, q15 sa, q15 sb, q15 *c, q15 *s) {
+  *c=q15acc(qsub((int32_t)ca*cb,(int32_t)sa*sb));
+  *s=q15acc(qadd((int32_t)sa*cb,(int32_t)ca*sb));
+}
+
+//Sine and cosine of a binary angle, where a full circle is 65536 parts, so that
+//angles wrap around for free. Quarter wave table with linear interpolation,
+//good to within two counts of q15.
+q15 sinb(uint16_t angle);
+static inline q15 cosb(uint16_t angle) {return sinb(angle+0x4000);}
+
+//Same angle units as sint() and cost() in float.h, tenths of a degree, but with
+//any angle from -3599 to 3599 allowed
+static inline uint16_t tenthsToBinary(int angle) {
+  //65536/3600 as 16.16 fixed point, rounded
+  if(angle<0) return (uint16_t)(0U-tenthsToBinary(-angle));
+  return (uint16_t)(((uint32_t)angle*1193046U+0x8000)>>16);
+}
+static inline q15 sinq(int angle) {return sinb(tenthsToBinary(angle));}
+static inline q15 cosq(int angle) {return cosb(tenthsToBinary(angle));}
+
+/** Evaluate a polynomial by Horner's rule, P[0]+P[1]*x+P[2]*x^2...
+\param x q31, so it must be between -1 and 1
+\param P coefficients, all in the same Q format, which can be any that holds
+them, for instance Q16.16 for coefficients up to 32768.
+\return Result in the same Q format as the coefficients, saturated
+*/
+q31 polyq(q31 x, const q31* P, int order);
+
+#endif
@@ -0,0 +1,229 @@
+/* Host check of the fixed point math in fixed.h against the same math done in
+double precision, and timing of it against the float code it stands in for.
+
+Usage: fixedCheck [-n cases] [-b loops] [-s seed]
+
+  -n  Number of random values for each check, default 1000000
+  -b  Calls per benchmark row, default 10000000
+  -s  Random seed, default 1
+
+Checks:
+
+  toQ15, toQ31  Exactly the rounded, saturated value, over random numbers from
+                -1.5 to 1.5 and the edges, where 0.99999 used to overflow
+  add, sub, mul Exactly the saturated result of the same math in 64 bits
+  sinb          Within 2 counts of 32767*sin() at every one of the 65536 angles
+  sinq, cosq    Within 2 counts of sinb, plus the sine of the half step in
+                rounding tenths of a degree to a binary angle, about 1.1e-4, of
+                sint() and cost() at every tenth of a degree
+  polyq         Within one count per order of the double result from the same
+                coefficients, with the coefficients in Q31 and in Q16.16
+
+Then it times sinq, cosq, polyq, and q31mul against sint, cost, poly, and a
+float multiply, over the same inputs. The host has a floating point unit, so
+float comes out about as fast as fixed point here or faster. On an ARM7, which
+does every float operation in a library call, the fixed point side wins by much
+more than it does here.
+
+Exit status is 0 if everything passed, 1 if not.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include "fixed.h"
+#include "float.h"
+
+//The conversions are meant for constants, so they had better work at compile time
+static_assert(toQ15(0.99999)==Q15_MAX,"toQ15 near 1");
+static_assert(toQ15(1.0)==Q15_MAX,"toQ15 of 1");
+static_assert(toQ15(-1.0)==Q15_MIN,"toQ15 of -1");
+static_assert(toQ15(-2.0)==Q15_MIN,"toQ15 below -1");
+static_assert(toQ15(0.5)==0x4000,"toQ15 of 0.5");
+static_assert(toQ31(0.9999999999)==Q31_MAX,"toQ31 near 1");
+static_assert(toQ31(-0.9999999999)==Q31_MIN,"toQ31 near -1");
+static_assert(toQ31(-0.5)==-0x40000000,"toQ31 of -0.5");
+
+static uint64_t rng;
+static uint64_t next() {
+  rng^=rng<<13;
+  rng^=rng>>7;
+  rng^=rng<<17;
+  return rng;
+}
+
+//Uniform from lo to hi
+static double uniform(double lo, double hi) {
+  return lo+(hi-lo)*(next()>>11)*(1.0/9007199254740992.0);
+}
+
+static uint32_t failed;
+
+static void fail(const char* what, double x, double got, double want) {
+  if(failed<20) printf("%s(%.17g) gave %.17g, should be %.17g\n",what,x,got,want);
+  failed++;
+}
+
+static int64_t clamp(int64_t x, int64_t lo, int64_t hi) {return x<lo?lo:x>hi?hi:x;}
+
+static void checkConvert(double x) {
+  int64_t want15=clamp(llround(x*32768.0),Q15_MIN,Q15_MAX);
+  int64_t want31=clamp(llround(x*2147483648.0),Q31_MIN,Q31_MAX);
+  if(toQ15(x)!=want15) fail("toQ15",x,toQ15(x),want15);
+  if(toQ31(x)!=want31) fail("toQ31",x,toQ31(x),want31);
+}
+
+static void checkArith(q31 a, q31 b) {
+  if(qadd(a,b)!=clamp((int64_t)a+b,Q31_MIN,Q31_MAX)) fail("qadd",a,qadd(a,b),clamp((int64_t)a+b,Q31_MIN,Q31_MAX));
+  if(qsub(a,b)!=clamp((int64_t)a-b,Q31_MIN,Q31_MAX)) fail("qsub",a,qsub(a,b),clamp((int64_t)a-b,Q31_MIN,Q31_MAX));
+  int64_t m31=clamp(((int64_t)a*b+0x40000000)>>31,Q31_MIN,Q31_MAX);
+  if(q31mul(a,b)!=m31) fail("q31mul",a,q31mul(a,b),m31);
+  q15 a15=(q15)(a>>16),b15=(q15)(b>>16);
+  int64_t m15=clamp(((int64_t)a15*b15+0x4000)>>15,Q15_MIN,Q15_MAX);
+  if(q15mul(a15,b15)!=m15) fail("q15mul",a15,q15mul(a15,b15),m15);
+  if(q15add(a15,b15)!=clamp((int64_t)a15+b15,Q15_MIN,Q15_MAX)) fail("q15add",a15,q15add(a15,b15),clamp((int64_t)a15+b15,Q15_MIN,Q15_MAX));
+  if(q15sub(a15,b15)!=clamp((int64_t)a15-b15,Q15_MIN,Q15_MAX)) fail("q15sub",a15,q15sub(a15,b15),clamp((int64_t)a15-b15,Q15_MIN,Q15_MAX));
+}
+
+//A random q31, often near the ends where saturation happens
+static q31 randomQ31() {
+  q31 x=(q31)(uint32_t)next();
+  switch(next()%4) {
+    case 0: return x>>(next()%31);
+    case 1: return Q31_MAX-(q31)(next()%256);
+    case 2: return Q31_MIN+(q31)(next()%256);
+    default: return x;
+  }
+}
+
+//Largest error of polyq on a polynomial with coefficients in Q(31-shift)
+static double checkPoly(const double* c, int order, int shift, uint32_t cases) {
+  q31 P[8];
+  double Pd[8];
+  double lsb=ldexp(1.0,shift-31);
+  for(int i=0;i<=order;i++) {
+    P[i]=(q31)llround(c[i]/lsb);
+    Pd[i]=P[i]*lsb;
+  }
+  double worst=0;
+  for(uint32_t i=0;i<cases;i++) {
+    q31 x=(q31)(uint32_t)next();
+    double xd=x/2147483648.0;
+    double want=Pd[order];
+    for(int j=order-1;j>=0;j--) want=want*xd+Pd[j];
+    double got=polyq(x,P,order)*lsb;
+    double err=fabs(got-want);
+    if(err>worst) worst=err;
+    if(err>order*lsb) fail("polyq",xd,got,want);
+  }
+  return worst;
+}
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+//Keeps the compiler from throwing away the results being timed
+static volatile uint32_t sinkI;
+static volatile float sinkF;
+
+//Time fixed(i) and flt(i) for i going around a table of nv inputs, and print ns
+//per call of each
+template<typename FixedFn, typename FloatFn>
+static void bench(const char* name, uint32_t nv, uint32_t loops, FixedFn fixed, FloatFn flt) {
+  uint32_t accI=0;
+  float accF=0;
+  double t0=now();
+  for(uint32_t i=0;i<loops;i++) accI+=(uint32_t)fixed(i%nv);
+  double t1=now();
+  for(uint32_t i=0;i<loops;i++) accF+=flt(i%nv);
+  double t2=now();
+  sinkI=accI;
+  sinkF=accF;
+  printf("%-20s %9.2f %9.2f %7.2fx\n",name,(t2-t1)*1e9/loops,(t1-t0)*1e9/loops,(t2-t1)/(t1-t0));
+}
+
+int main(int argc, char** argv) {
+  uint32_t cases=1000000;
+  uint32_t loops=10000000;
+  rng=1;
+  int opt;
+  while((opt=getopt(argc,argv,"n:b:s:"))!=-1) {
+    switch(opt) {
+      case 'n': cases=strtoul(optarg,nullptr,0);break;
+      case 'b': loops=strtoul(optarg,nullptr,0);break;
+      case 's': rng=strtoull(optarg,nullptr,0);if(rng==0) rng=1;break;
+      default:
+        fprintf(stderr,"Usage: %s [-n cases] [-b loops] [-s seed]\n",argv[0]);
+        return 1;
+    }
+  }
+
+  uint32_t before=failed;
+  static const double edges[]={0,0.5,-0.5,0.99999,-0.99999,0.9999999999,-0.9999999999,1,-1,1.5,-1.5,
+                               32767.4/32768,32767.5/32768,-32767.5/32768,-32768.5/32768,
+                               2147483647.4/2147483648,2147483647.5/2147483648,-2147483648.5/2147483648};
+  for(double e: edges) checkConvert(e);
+  for(uint32_t i=0;i<cases;i++) checkConvert(uniform(-1.5,1.5));
+  printf("toQ15, toQ31: %s\n",failed==before?"ok":"FAILED");
+
+  before=failed;
+  for(uint32_t i=0;i<cases;i++) checkArith(randomQ31(),randomQ31());
+  printf("add, sub, mul: %s\n",failed==before?"ok":"FAILED");
+
+  before=failed;
+  int worstSinb=0;
+  for(uint32_t a=0;a<65536;a++) {
+    int want=(int)lround(32767*sin(a*M_PI/32768));
+    int err=abs(sinb((uint16_t)a)-want);
+    if(err>worstSinb) worstSinb=err;
+    if(err>2) fail("sinb",a,sinb((uint16_t)a),want);
+  }
+  printf("sinb: worst %d counts, %s\n",worstSinb,failed==before?"ok":"FAILED");
+
+  before=failed;
+  const double sinqLimit=2/32768.0+M_PI/65536;
+  double worstSinq=0;
+  for(int a=-3599;a<=3599;a++) {
+    double es=fabs(fromQ15(sinq(a))-sint(a));
+    double ec=fabs(fromQ15(cosq(a))-cost(a));
+    if(es>worstSinq) worstSinq=es;
+    if(ec>worstSinq) worstSinq=ec;
+    if(es>sinqLimit) fail("sinq",a,fromQ15(sinq(a)),sint(a));
+    if(ec>sinqLimit) fail("cosq",a,fromQ15(cosq(a)),cost(a));
+  }
+  printf("sinq, cosq: worst %.3g, %s\n",worstSinq,failed==before?"ok":"FAILED");
+
+  before=failed;
+  static const double quad[]={0.25,-0.5,0.125};
+  static const double cubic[]={1000.5,-2000.25,300.125,-40.0625};
+  double w31=checkPoly(quad,2,0,cases);
+  double w16=checkPoly(cubic,3,15,cases);
+  printf("polyq: worst %.3g in Q31, %.3g in Q16.16, %s\n",w31,w16,failed==before?"ok":"FAILED");
+
+  //The same random inputs for both sides of each row, in each one's own format
+  static const uint32_t nv=4096;
+  static int angle[nv];
+  static q31 xq[nv];
+  static fp  xf[nv];
+  for(uint32_t i=0;i<nv;i++) {
+    angle[i]=(int)(next()%7199)-3599;
+    xq[i]=(q31)(uint32_t)next();
+    xf[i]=fromQ31(xq[i]);
+  }
+  static const q31 Pq[]={toQ31(0.25),toQ31(-0.5),toQ31(0.125),toQ31(-0.0625)};
+  static const fp  Pf[]={0.25f,-0.5f,0.125f,-0.0625f};
+  const q31 kq=toQ31(0.7071);
+  const fp  kf=0.7071f;
+  printf("call                  float(ns)  fixed(ns) speedup\n");
+  bench("sinq / sint", nv,loops,[&](uint32_t i){return (int32_t)sinq(angle[i]);},[&](uint32_t i){return sint(angle[i]);});
+  bench("cosq / cost", nv,loops,[&](uint32_t i){return (int32_t)cosq(angle[i]);},[&](uint32_t i){return cost(angle[i]);});
+  bench("polyq / poly",nv,loops,[&](uint32_t i){return polyq(xq[i],Pq,3);},   [&](uint32_t i){return poly(xf[i],Pf,3);});
+  bench("q31mul / *",  nv,loops,[&](uint32_t i){return q31mul(xq[i],kq);},    [&](uint32_t i){return xf[i]*kf;});
+
+  return failed==0?0:1;
+}
@@ -1,6 +1,9 @@
 #include "float.h"
 
+//Leave the table out of flash if fixed point was chosen, see real.h
+#ifndef REAL_FIXED
 #include "sinShort.h"
+#endif
 
 fp poly(fp x, const fp* P, int order) {
   fp acc=P[order];
@@ -0,0 +1,38 @@
+#ifndef real_h
+#define real_h
+
+#include "float.h"
+#include "fixed.h"
+
+//Compile time choice between float and fixed point, for code which should be
+//able to run either way. Write it using real, REAL() for constants, and the
+//functions below, then pick fixed point in the program Makefile like this:
+//
+//CDEFS += -DREAL_FIXED
+//
+//In fixed point, real is q31, so every value must stay between -1 and 1. Scale
+//things to fit. With REAL_FIXED, the float sine table is left out of flash, so
+//sint() and cost() may not be used directly.
+#ifdef REAL_FIXED
+typedef q31 real;
+#define REAL(x) toQ31(x)
+static inline real rmul(real a, real b) {return q31mul(a,b);}
+static inline real radd(real a, real b) {return qadd(a,b);}
+static inline real rsub(real a, real b) {return qsub(a,b);}
+static inline real rsin(int angle) {return ((q31)sinq(angle))<<16;}
+static inline real rcos(int angle) {return ((q31)cosq(angle))<<16;}
+static inline real rpoly(real x, const real* P, int order) {return polyq(x,P,order);}
+static inline fp rtofp(real x) {return fromQ31(x);}
+#else
+typedef fp real;
+#define REAL(x) ((fp)(x))
+static inline real rmul(real a, real b) {return a*b;}
+static inline real radd(real a, real b) {return a+b;}
+static inline real rsub(real a, real b) {return a-b;}
+static inline real rsin(int angle) {return sint(angle);}
+static inline real rcos(int angle) {return cost(angle);}
+static inline real rpoly(real x, const real* P, int order) {return poly(x,P,order);}
+static inline fp rtofp(real x) {return x;}
+#endif
+
+#endif
@@ -0,0 +1,261 @@
+//Quarter wave sine table for sinb(), 256 steps from 0 to 90 degrees inclusive.
+//Generated as round(32767*sin(i*pi/512))
+const q15 sinQ15Table[257]={
+/*00.000*/      0,
+/*00.352*/    201,
+/*00.703*/    402,
+/*01.055*/    603,
+/*01.406*/    804,
+/*01.758*/   1005,
+/*02.109*/   1206,
+/*02.461*/   1407,
+/*02.812*/   1608,
+/*03.164*/   1809,
+/*03.516*/   2009,
+/*03.867*/   2210,
+/*04.219*/   2410,
+/*04.570*/   2611,
+/*04.922*/   2811,
+/*05.273*/   3012,
+/*05.625*/   3212,
+/*05.977*/   3412,
+/*06.328*/   3612,
+/*06.680*/   3811,
+/*07.031*/   4011,
+/*07.383*/   4210,
+/*07.734*/   4410,
+/*08.086*/   4609,
+/*08.438*/   4808,
+/*08.789*/   5007,
+/*09.141*/   5205,
+/*09.492*/   5404,
+/*09.844*/   5602,
+/*10.195*/   5800,
+/*10.547*/   5998,
+/*10.898*/   6195,
+/*11.250*/   6393,
+/*11.602*/   6590,
+/*11.953*/   6786,
+/*12.305*/   6983,
+/*12.656*/   7179,
+/*13.008*/   7375,
+/*13.359*/   7571,
+/*13.711*/   7767,
+/*14.062*/   7962,
+/*14.414*/   8157,
+/*14.766*/   8351,
+/*15.117*/   8545,
+/*15.469*/   8739,
+/*15.820*/   8933,
+/*16.172*/   9126,
+/*16.523*/   9319,
+/*16.875*/   9512,
+/*17.227*/   9704,
+/*17.578*/   9896,
+/*17.930*/  10087,
+/*18.281*/  10278,
+/*18.633*/  10469,
+/*18.984*/  10659,
+/*19.336*/  10849,
+/*19.688*/  11039,
+/*20.039*/  11228,
+/*20.391*/  11417,
+/*20.742*/  11605,
+/*21.094*/  11793,
+/*21.445*/  11980,
+/*21.797*/  12167,
+/*22.148*/  12353,
+/*22.500*/  12539,
+/*22.852*/  12725,
+/*23.203*/  12910,
+/*23.555*/  13094,
+/*23.906*/  13279,
+/*24.258*/  13462,
+/*24.609*/  13645,
+/*24.961*/  13828,
+/*25.312*/  14010,
+/*25.664*/  14191,
+/*26.016*/  14372,
+/*26.367*/  14553,
+/*26.719*/  14732,
+/*27.070*/  14912,
+/*27.422*/  15090,
+/*27.773*/  15269,
+/*28.125*/  15446,
+/*28.477*/  15623,
+/*28.828*/  15800,
+/*29.180*/  15976,
+/*29.531*/  16151,
+/*29.883*/  16325,
+/*30.234*/  16499,
+/*30.586*/  16673,
+/*30.938*/  16846,
+/*31.289*/  17018,
+/*31.641*/  17189,
+/*31.992*/  17360,
+/*32.344*/  17530,
+/*32.695*/  17700,
+/*33.047*/  17869,
+/*33.398*/  18037,
+/*33.750*/  18204,
+/*34.102*/  18371,
+/*34.453*/  18537,
+/*34.805*/  18703,
+/*35.156*/  18868,
+/*35.508*/  19032,
+/*35.859*/  19195,
+/*36.211*/  19357,
+/*36.562*/  19519,
+/*36.914*/  19680,
+/*37.266*/  19841,
+/*37.617*/  20000,
+/*37.969*/  20159,
+/*38.320*/  20317,
+/*38.672*/  20475,
+/*39.023*/  20631,
+/*39.375*/  20787,
+/*39.727*/  20942,
+/*40.078*/  21096,
+/*40.430*/  21250,
+/*40.781*/  21403,
+/*41.133*/  21554,
+/*41.484*/  21705,
+/*41.836*/  21856,
+/*42.188*/  22005,
+/*42.539*/  22154,
+/*42.891*/  22301,
+/*43.242*/  22448,
+/*43.594*/  22594,
+/*43.945*/  22739,
+/*44.297*/  22884,
+/*44.648*/  23027,
+/*45.000*/  23170,
+/*45.352*/  23311,
+/*45.703*/  23452,
+/*46.055*/  23592,
+/*46.406*/  23731,
+/*46.758*/  23870,
+/*47.109*/  24007,
+/*47.461*/  24143,
+/*47.812*/  24279,
+/*48.164*/  24413,
+/*48.516*/  24547,
+/*48.867*/  24680,
+/*49.219*/  24811,
+/*49.570*/  24942,
+/*49.922*/  25072,
+/*50.273*/  25201,
+/*50.625*/  25329,
+/*50.977*/  25456,
+/*51.328*/  25582,
+/*51.680*/  25708,
+/*52.031*/  25832,
+/*52.383*/  25955,
+/*52.734*/  26077,
+/*53.086*/  26198,
+/*53.438*/  26319,
+/*53.789*/  26438,
+/*54.141*/  26556,
+/*54.492*/  26674,
+/*54.844*/  26790,
+/*55.195*/  26905,
+/*55.547*/  27019,
+/*55.898*/  27133,
+/*56.250*/  27245,
+/*56.602*/  27356,
+/*56.953*/  27466,
+/*57.305*/  27575,
+/*57.656*/  27683,
+/*58.008*/  27790,
+/*58.359*/  27896,
+/*58.711*/  28001,
+/*59.062*/  28105,
+/*59.414*/  28208,
+/*59.766*/  28310,
+/*60.117*/  28411,
+/*60.469*/  28510,
+/*60.820*/  28609,
+/*61.172*/  28706,
+/*61.523*/  28803,
+/*61.875*/  28898,
+/*62.227*/  28992,
+/*62.578*/  29085,
+/*62.930*/  29177,
+/*63.281*/  29268,
+/*63.633*/  29358,
+/*63.984*/  29447,
+/*64.336*/  29534,
+/*64.688*/  29621,
+/*65.039*/  29706,
+/*65.391*/  29791,
+/*65.742*/  29874,
+/*66.094*/  29956,
+/*66.445*/  30037,
+/*66.797*/  30117,
+/*67.148*/  30195,
+/*67.500*/  30273,
+/*67.852*/  30349,
+/*68.203*/  30424,
+/*68.555*/  30498,
+/*68.906*/  30571,
+/*69.258*/  30643,
+/*69.609*/  30714,
+/*69.961*/  30783,
+/*70.312*/  30852,
+/*70.664*/  30919,
+/*71.016*/  30985,
+/*71.367*/  31050,
+/*71.719*/  31113,
+/*72.070*/  31176,
+/*72.422*/  31237,
+/*72.773*/  31297,
+/*73.125*/  31356,
+/*73.477*/  31414,
+/*73.828*/  31470,
+/*74.180*/  31526,
+/*74.531*/  31580,
+/*74.883*/  31633,
+/*75.234*/  31685,
+/*75.586*/  31736,
+/*75.938*/  31785,
+/*76.289*/  31833,
+/*76.641*/  31880,
+/*76.992*/  31926,
+/*77.344*/  31971,
+/*77.695*/  32014,
+/*78.047*/  32057,
+/*78.398*/  32098,
+/*78.750*/  32137,
+/*79.102*/  32176,
+/*79.453*/  32213,
+/*79.805*/  32250,
+/*80.156*/  32285,
+/*80.508*/  32318,
+/*80.859*/  32351,
+/*81.211*/  32382,
+/*81.562*/  32412,
+/*81.914*/  32441,
+/*82.266*/  32469,
+/*82.617*/  32495,
+/*82.969*/  32521,
+/*83.320*/  32545,
+/*83.672*/  32567,
+/*84.023*/  32589,
+/*84.375*/  32609,
+/*84.727*/  32628,
+/*85.078*/  32646,
+/*85.430*/  32663,
+/*85.781*/  32678,
+/*86.133*/  32692,
+/*86.484*/  32705,
+/*86.836*/  32717,
+/*87.188*/  32728,
+/*87.539*/  32737,
+/*87.891*/  32745,
+/*88.242*/  32752,
+/*88.594*/  32757,
+/*88.945*/  32761,
+/*89.297*/  32765,
+/*89.648*/  32766,
+/*90.000*/  32767
+};
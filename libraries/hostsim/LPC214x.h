@@ -0,0 +1,54 @@
+#ifndef __LPC214x_H
+#define __LPC214x_H
+
+/* Host stand-in for LPC214x.h, see hostsim.h. Only the timer registers are
+here, since they are all the host-simulated code uses. Each one is a SimReg,
+which reads and writes like the hardware register. */
+
+#include "hostsim.h"
+
+#define TIR(port)           hostSim.timerReg(port,0x00)
+#define TTCR(port)          hostSim.timerReg(port,0x04)
+#define TTC(port)           hostSim.timerReg(port,0x08)
+#define TPR(port)           hostSim.timerReg(port,0x0C)
+#define TPC(port)           hostSim.timerReg(port,0x10)
+#define TMCR(port)          hostSim.timerReg(port,0x14)
+#define TMR(port,channel)   hostSim.timerReg(port,0x18+(channel)*4)
+#define TMR0(port)          TMR(port,0)
+#define TMR1(port)          TMR(port,1)
+#define TMR2(port)          TMR(port,2)
+#define TMR3(port)          TMR(port,3)
+#define TCCR(port)          hostSim.timerReg(port,0x28)
+#define TCR(port,channel)   hostSim.timerReg(port,0x2C+(channel)*4)
+#define TCR0(port)          TCR(port,0)
+#define TCR1(port)          TCR(port,1)
+#define TCR2(port)          TCR(port,2)
+#define TCR3(port)          TCR(port,3)
+#define TEMR(port)          hostSim.timerReg(port,0x3C)
+#define TCTCR(port)         hostSim.timerReg(port,0x70)
+
+/* Timer 0 */
+#define T0IR     TIR(0)
+#define T0TCR    TTCR(0)
+#define T0TC     TTC(0)
+#define T0PR     TPR(0)
+#define T0PC     TPC(0)
+#define T0MCR    TMCR(0)
+#define T0MR0    TMR(0,0)
+#define T0MR1    TMR(0,1)
+#define T0MR2    TMR(0,2)
+#define T0MR3    TMR(0,3)
+
+/* Timer 1 */
+#define T1IR     TIR(1)
+#define T1TCR    TTCR(1)
+#define T1TC     TTC(1)
+#define T1PR     TPR(1)
+#define T1PC     TPC(1)
+#define T1MCR    TMCR(1)
+#define T1MR0    TMR(1,0)
+#define T1MR1    TMR(1,1)
+#define T1MR2    TMR(1,2)
+#define T1MR3    TMR(1,3)
+
+#endif
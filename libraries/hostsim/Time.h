@@ -0,0 +1,34 @@
+#ifndef Time_h
+#define Time_h
+
+/* Host stand-in for Time.h, see hostsim.h. Timer 0 is expected to be set up
+the way the firmware does it, counting PCLK and wrapping once a minute, which
+setupTimer0() does for a simulation. */
+
+#include <cinttypes>
+#include "hostsim.h"
+#include "LPC214x.h"
+
+class Time {
+public:
+  static const uint32_t PCLK=60'000'000;
+  static const uint32_t timerSec=60;
+};
+
+/** Whole seconds of simulated time */
+inline uint32_t uptime() {
+  return (uint32_t)(hostSim.now()/Time::PCLK);
+}
+
+/** Start timer 0 counting PCLK, reset on match 0 once every timerSec seconds,
+with no interrupt */
+inline void setupTimer0() {
+  TTCR(0)=(1<<1);
+  TCTCR(0)=0;
+  TMCR(0)=(1<<1);
+  TMR0(0)=Time::PCLK*Time::timerSec-1;
+  TPR(0)=0;
+  TTCR(0)=(1<<0);
+}
+
+#endif
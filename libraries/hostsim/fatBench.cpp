@@ -0,0 +1,292 @@
+/* Host benchmark of the filesystem stack, running the real Partition,
+BlockCache, and fat sources against the file-backed SD card in sdhc.h.
+
+Usage: fatBench [-f image] [-n logs] [-a MiB] [-c sectors] [-s MiB] [-k]
+
+  -f  Disk image to use, default fatBench.img. It is formatted FAT32 first,
+      with one partition starting 4MiB into the card, the way SD cards come.
+  -n  Number of logs already on the card before the new one is opened,
+      default 0. Each is one block long. The root directory holds
+      sectors*16 entries.
+  -a  MiB to append to the log, default 1024
+  -c  Sectors per cluster, default 64 (32kiB), as SDHC cards are formatted.
+      On FAT32, the root directory is one cluster.
+  -s  Size of the partition in MiB. Default is enough for the log, and at
+      least big enough to be FAT32.
+  -k  Keep the image afterwards. The image is sparse, so it only takes up
+      about as much room as the log.
+
+This does what the firmware does. Mount is Partition::begin(1) and
+Cluster::begin(). Prefill writes the old logs, rkto0000.sds and up. Probe is
+how openLog() used to look for the next log number, with a find() of each name
+in turn until one isn't there. Open is openLog() now: findHighest() on the log
+names, then openw() of the next one. Append is what FileCircular does for each block, an
+append() without writing the directory, then sync(). Then the log is read back
+with readStream() and checked.
+
+Each step reports the blocks read from and written to the card, the commands
+sent, the BlockCache hit rate, and the bytes clocked over the SPI bus for block
+transfers. The firmware runs the SPI bus at 15MHz or less, so the bus bytes give
+a floor on how long each step takes on the card.
+
+Exit status is 0 if everything worked and read back correctly, 1 if not.
+*/
+//Before stdio.h, whose EOF macro has the same name as Cluster::EOF
+#include "sdhc.h"
+#include "Partition.h"
+#include "cluster.h"
+#include "direntry.h"
+#include "file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+static const uint32_t partStart=8192; ///< First sector of the partition, 4MiB in
+static const uint32_t reservedSectors=32;
+
+static void put16(char* p, uint16_t v) {p[0]=v & 0xFF;p[1]=v>>8;}
+static void put32(char* p, uint32_t v) {put16(p,v & 0xFFFF);put16(p+2,v>>16);}
+
+/** Lay down an empty FAT32 filesystem. The image is truncated to nothing first,
+so everything not written here reads back as zeros.
+*/
+static bool format(int fd, uint32_t partSectors, uint32_t spc) {
+  uint32_t entries=partSectors/spc+2; //Cluster::begin() counts clusters like this
+  uint32_t fatSectors=(entries*4+511)/512;
+  if(ftruncate(fd,0)!=0) return false;
+  if(ftruncate(fd,((off_t)partStart+partSectors)*512)!=0) return false;
+  char s[512];
+
+  memset(s,0,sizeof(s));
+  char* pe=s+0x1be;
+  pe[4]=0x0C; //FAT32 with LBA
+  put32(pe+8,partStart);
+  put32(pe+12,partSectors);
+  s[510]=0x55;s[511]=0xAA;
+  if(pwrite(fd,s,512,0)!=512) return false;
+
+  memset(s,0,sizeof(s));
+  s[0]=0xEB;s[1]=0x58;s[2]=0x90;
+  memcpy(s+3,"MSWIN4.1",8);
+  put16(s+0x0B,512);
+  s[0x0D]=spc;
+  put16(s+0x0E,reservedSectors);
+  s[0x10]=2;
+  s[0x15]=0xF8;
+  put16(s+0x18,63);
+  put16(s+0x1A,255);
+  put32(s+0x1C,partStart);
+  put32(s+0x20,partSectors);
+  put32(s+0x24,fatSectors);
+  put32(s+0x2C,2);
+  put16(s+0x30,1);
+  put16(s+0x32,6);
+  s[0x40]=0x80;
+  s[0x42]=0x29;
+  put32(s+0x43,0x4B57414E);
+  memcpy(s+0x47,"NO NAME    FAT32   ",19);
+  s[510]=0x55;s[511]=0xAA;
+  if(pwrite(fd,s,512,(off_t)partStart*512)!=512) return false;
+  if(pwrite(fd,s,512,(off_t)(partStart+6)*512)!=512) return false;
+
+  memset(s,0,sizeof(s));
+  put32(s,0x41615252);
+  put32(s+484,0x61417272);
+  put32(s+488,0xFFFFFFFF);
+  put32(s+492,0xFFFFFFFF);
+  put32(s+508,0xAA550000);
+  if(pwrite(fd,s,512,(off_t)(partStart+1)*512)!=512) return false;
+  if(pwrite(fd,s,512,(off_t)(partStart+7)*512)!=512) return false;
+
+  //Media descriptor, reserved entry, and the end of the root directory chain
+  memset(s,0,sizeof(s));
+  put32(s,  0x0FFFFFF8);
+  put32(s+4,0x0FFFFFFF);
+  put32(s+8,0x0FFFFFFF);
+  for(int i=0;i<2;i++) {
+    if(pwrite(fd,s,512,(off_t)(partStart+reservedSectors+i*fatSectors)*512)!=512) return false;
+  }
+  return true;
+}
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec+t.tv_nsec*1e-9;
+}
+
+//BlockCache counts bus bytes in 32 bits, which a long append wraps. Poll it at
+//least every few GB to carry the count on in 64 bits.
+static uint64_t busBytes;
+static uint32_t lastBusBytes;
+static uint64_t pollBus(BlockCache& cache) {
+  uint32_t b=cache.getBusBytes();
+  busBytes+=b-lastBusBytes;
+  lastBusBytes=b;
+  return busBytes;
+}
+
+/** Counts of card traffic at one moment, so that each step can report the difference */
+struct Snapshot {
+  uint32_t reads,writes,commands,hits,misses;
+  uint64_t busBytes;
+  double wall;
+  void take(SDHC& sd, BlockCache& cache) {
+    reads=sd.blockReads;writes=sd.blockWrites;commands=sd.commands;
+    hits=cache.getHits();misses=cache.getMisses();busBytes=pollBus(cache);
+    wall=now();
+  }
+};
+
+static void header() {
+  printf("step       SD reads  SD writes  commands   hits  misses hit rate     bus bytes  wall(s)\n");
+}
+
+static void report(const char* step, const Snapshot& a, const Snapshot& b) {
+  uint32_t hits=b.hits-a.hits,misses=b.misses-a.misses;
+  printf("%-9s %9u %10u %9u %6u %7u %7.1f%% %13" PRIu64 " %8.3f\n",step,b.reads-a.reads,b.writes-a.writes,b.commands-a.commands,
+         hits,misses,hits+misses?100.0*hits/(hits+misses):0.0,b.busBytes-a.busBytes,b.wall-a.wall);
+}
+
+//Fill a block with something which tells where it belongs in the log
+static void pattern(char* buf, uint32_t block) {
+  for(int i=0;i<SDHC::BLOCK_SIZE;i+=4) put32(buf+i,block*0x9E3779B1+i);
+}
+
+int main(int argc, char** argv) {
+  const char* image="fatBench.img";
+  uint32_t appendMiB=1024;
+  uint32_t logs=0;
+  uint32_t spc=64;
+  uint32_t partMiB=0;
+  bool keep=false;
+  int opt;
+  while((opt=getopt(argc,argv,"f:n:a:c:s:k"))!=-1) {
+    switch(opt) {
+      case 'f': image=optarg;break;
+      case 'n': logs=strtoul(optarg,nullptr,0);break;
+      case 'a': appendMiB=strtoul(optarg,nullptr,0);break;
+      case 'c': spc=strtoul(optarg,nullptr,0);break;
+      case 's': partMiB=strtoul(optarg,nullptr,0);break;
+      case 'k': keep=true;break;
+      default: goto usage;
+    }
+  }
+  if(spc==0 || spc>128 || (spc & (spc-1))!=0 || appendMiB>=4096 || logs>=spc*16 || logs>9999) {
+usage:
+    fprintf(stderr,"Usage: %s [-f image] [-n logs] [-a MiB] [-c sectors] [-s MiB] [-k]\n",argv[0]);
+    return 1;
+  }
+  {
+    //Room for the log and the tables, and enough clusters that Cluster::begin() calls it FAT32
+    uint64_t need=(uint64_t)appendMiB*2048+(uint64_t)appendMiB*2048/64+65536;
+    uint64_t fat32=(uint64_t)65525*spc+spc;
+    if(need<fat32) need=fat32;
+    uint64_t partSectors=partMiB?(uint64_t)partMiB*2048:need;
+    if(partSectors<fat32 || partSectors+partStart>0xFFFFFFFFULL) {
+      fprintf(stderr,"Partition must be between %" PRIu64 " and %" PRIu64 " MiB with %u sectors per cluster\n",fat32/2048+1,(uint64_t)(0xFFFFFFFFULL-partStart)/2048,spc);
+      return 1;
+    }
+    int fd=open(image,O_RDWR|O_CREAT,0644);
+    if(fd<0) {perror(image);return 1;}
+    if(!format(fd,partSectors,spc)) {perror("format");return 1;}
+    close(fd);
+    printf("%s: %" PRIu64 " MiB partition, %u sectors per cluster, %u logs already there, appending %u MiB\n",image,partSectors/2048,spc,logs,appendMiB);
+  }
+
+  int fd=open(image,O_RDWR);
+  if(fd<0) {perror(image);return 1;}
+  SDHC sd(fd);
+  Partition p(sd);
+  Cluster fs(p);
+  File f(fs);
+  Snapshot a,b;
+  bool ok=true;
+  header();
+
+  a.take(sd,p.cache);
+  if(!sd.begin()) {printf("sd.begin() failed\n");return 1;}
+  if(!p.begin(1)) {printf("p.begin() failed, status %d\n",p.errno);return 1;}
+  if(!fs.begin()) {printf("fs.begin() failed, status %d\n",fs.errno);return 1;}
+  b.take(sd,p.cache);
+  report("mount",a,b);
+
+  char buf[SDHC::BLOCK_SIZE];
+  char fn[13];
+  if(logs>0) {
+    a=b;
+    memset(buf,0,sizeof(buf));
+    for(uint32_t i=0;i<logs;i++) {
+      snprintf(fn,sizeof(fn),"rkto%04u.sds",i);
+      if(!f.openw(fn) || !f.append(buf) || !f.close()) {printf("Couldn't write %s, status %d\n",fn,f.errno);return 1;}
+    }
+    b.take(sd,p.cache);
+    report("prefill",a,b);
+  }
+
+  a=b;
+  int log_i=0;
+  snprintf(fn,sizeof(fn),"rkto%04d.sds",log_i);
+  while(log_i<9999 && f.find(fn)) {
+    log_i++;
+    snprintf(fn,sizeof(fn),"rkto%04d.sds",log_i);
+  }
+  b.take(sd,p.cache);
+  report("probe",a,b);
+
+  a=b;
+  int highest;
+  if(!f.findHighest("rkto####.sds",highest)) {printf("findHighest() failed, status %d\n",f.errno);return 1;}
+  if(highest+1!=log_i) {printf("findHighest() says the next log is %d, probing says %d\n",highest+1,log_i);ok=false;}
+  log_i=highest+1;
+  snprintf(fn,sizeof(fn),"rkto%04d.sds",log_i);
+  if(!f.openw(fn)) {printf("openw(\"%s\") failed, status %d\n",fn,f.errno);return 1;}
+  b.take(sd,p.cache);
+  report("open",a,b);
+
+  a=b;
+  uint32_t blocks=appendMiB*2048;
+  for(uint32_t i=0;i<blocks;i++) {
+    pattern(buf,i);
+    if(!f.append(buf,false)) {printf("append() of block %u failed, status %d\n",i,f.errno);return 1;}
+    if(!f.sync()) {printf("sync() after block %u failed, status %d\n",i,f.errno);return 1;}
+    if(i%2048==0) pollBus(p.cache);
+  }
+  b.take(sd,p.cache);
+  report("append",a,b);
+  double appendBus=b.busBytes-a.busBytes;
+
+  a=b;
+  File r(fs);
+  if(!r.openr(fn)) {printf("openr(\"%s\") failed, status %d\n",fn,r.errno);return 1;}
+  if(r.size()!=blocks*SDHC::BLOCK_SIZE) {printf("Size is %u, should be %u\n",r.size(),blocks*SDHC::BLOCK_SIZE);ok=false;}
+  char want[SDHC::BLOCK_SIZE];
+  uint32_t bad=0;
+  for(uint32_t i=0;i<blocks;i++) {
+    if(!r.readStream(buf)) {printf("readStream() of block %u failed, status %d\n",i,r.errno);ok=false;break;}
+    pattern(want,i);
+    if(memcmp(buf,want,sizeof(want))!=0) {
+      if(bad==0) printf("Block %u of the log reads back wrong\n",i);
+      bad++;
+    }
+    if(i%2048==0) pollBus(p.cache);
+  }
+  r.readStop();
+  b.take(sd,p.cache);
+  report("readback",a,b);
+  if(bad>0) {printf("%u blocks read back wrong\n",bad);ok=false;}
+
+  printf("total bus bytes %" PRIu64 "\n",busBytes);
+  if(blocks>0) {
+    printf("append: %.3f bus bytes per byte of log, %.1f s of bus time at 15MHz for %u MiB\n",
+           appendBus/((double)blocks*SDHC::BLOCK_SIZE),appendBus*8/15e6,appendMiB);
+  }
+  printf("sectorPool high water %d of %d, %u failures\n",sectorPool.getHighWater(),sectorPool.size,sectorPool.getFailures());
+  close(fd);
+  if(!keep) unlink(image);
+  return ok?0:1;
+}
@@ -0,0 +1,35 @@
+#ifndef gpio_h
+#define gpio_h
+
+/* Host stand-in for gpio.h, see hostsim.h. Outputs show up on the input
+register, as if nothing else were driving the pins. */
+
+#include "hostsim.h"
+
+class GPIODriver {
+public:
+  void pinMode(int pinNumber, bool output) {
+    if(output) {
+      hostSim.fioDir|= (1 << pinNumber);
+    } else {
+      hostSim.fioDir&=~ (1 << pinNumber);
+    }
+  }
+  void digitalWrite(int pinNumber, bool high) {
+    if(high) {
+      hostSim.fioPin|= (1<<pinNumber);
+    } else {
+      hostSim.fioPin&=~(1<<pinNumber);
+    }
+  }
+  bool digitalRead(int pinNumber) {
+    return (hostSim.fioPin>>pinNumber) & 1;
+  }
+};
+
+inline GPIODriver GPIO;
+inline void pinMode(int pinNumber, bool output) {GPIO.pinMode(pinNumber,output);}
+inline bool digitalRead(int pinNumber) {return GPIO.digitalRead(pinNumber);}
+inline void digitalWrite(int pinNumber, bool high) {GPIO.digitalWrite(pinNumber,high);}
+
+#endif
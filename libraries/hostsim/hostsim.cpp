@@ -0,0 +1,191 @@
+#include <string.h>
+#include "hostsim.h"
+
+static const int TIMER0=4; ///< VIC source of timer 0, the others follow it
+
+void HostSimulator::reset() {
+  memset(timer,0,sizeof(timer));
+  intEnable=0;
+  for(int i=0;i<VIC_SIZE;i++) {
+    vectAddr[i]=nullptr;
+    vectCntl[i]=0;
+  }
+  cpsr=I_Bit | F_Bit;
+  inIrq=false;
+  clock=0;
+  readCost=0;
+  interrupts=0;
+  unhandled=0;
+  regReads=0;
+  regWrites=0;
+  fioDir=0;
+  fioPin=0;
+  pinsel[0]=0;
+  pinsel[1]=0;
+}
+
+//Ticks until TC next lands on a match register which has something to do on
+//match, or ~0 if none will
+uint64_t HostSimulator::Timer::ticksToMatch() const {
+  if(!running()) return ~0ULL;
+  uint64_t best=~0ULL;
+  for(int ch=0;ch<4;ch++) {
+    if(((MCR>>(ch*3)) & 7)==0) continue;
+    //Counts until TC equals MR, going around the 32-bit corner if need be. A
+    //reset on match is itself a match, so it is always found first if it
+    //comes before this one.
+    uint64_t counts;
+    if(resetPending) {
+      counts=1+(uint64_t)MR[ch];
+    } else {
+      counts=(uint32_t)(MR[ch]-TC);
+      if(counts==0) counts=1ULL<<32;
+    }
+    if(counts<best) best=counts;
+  }
+  if(best==~0ULL) return best;
+  //Ticks until the first count, then a whole prescale period for each of the rest
+  return (PR-PC+1)+(best-1)*((uint64_t)PR+1);
+}
+
+void HostSimulator::Timer::run(uint64_t ticks) {
+  if(!running() || ticks==0) return;
+  uint64_t total=PC+ticks;
+  uint64_t counts=total/((uint64_t)PR+1);
+  PC=total%((uint64_t)PR+1);
+  if(counts==0) return;
+  if(resetPending) {
+    TC=0;
+    counts--;
+    resetPending=false;
+  }
+  TC+=(uint32_t)counts;
+  for(int ch=0;ch<4;ch++) {
+    uint32_t action=(MCR>>(ch*3)) & 7;
+    if(action==0 || TC!=MR[ch]) continue;
+    if(action & 1) IR|=1<<ch;
+    if(action & 2) resetPending=true;
+    if(action & 4) TCR&=~1;
+  }
+}
+
+uint32_t HostSimulator::read(int port, uint32_t offset) {
+  Timer& t=timer[port];
+  regReads++;
+  switch(offset) {
+    case 0x00: return t.IR;
+    case 0x04: return t.TCR;
+    case 0x08:
+      if(readCost>0) advance(readCost);
+      return t.TC;
+    case 0x0C: return t.PR;
+    case 0x10: return t.PC;
+    case 0x14: return t.MCR;
+    case 0x18: case 0x1C: case 0x20: case 0x24: return t.MR[(offset-0x18)/4];
+    case 0x28: return t.CCR;
+    case 0x2C: case 0x30: case 0x34: case 0x38: return t.CR[(offset-0x2C)/4];
+    case 0x3C: return t.EMR;
+    case 0x70: return t.CTCR;
+  }
+  return 0;
+}
+
+void HostSimulator::write(int port, uint32_t offset, uint32_t v) {
+  Timer& t=timer[port];
+  regWrites++;
+  switch(offset) {
+    case 0x00: t.IR&=~v;break;
+    case 0x04:
+      t.TCR=v & 3;
+      if(v & 2) {
+        t.TC=0;
+        t.PC=0;
+        t.resetPending=false;
+      }
+      break;
+    case 0x08: t.TC=v;t.resetPending=false;break;
+    case 0x0C: t.PR=v;break;
+    case 0x10: t.PC=v;break;
+    case 0x14: t.MCR=v & 0xFFF;break;
+    case 0x18: case 0x1C: case 0x20: case 0x24: t.MR[(offset-0x18)/4]=v;break;
+    case 0x28: t.CCR=v;break;
+    case 0x3C: t.EMR=v;break;
+    case 0x70: t.CTCR=v;break;
+  }
+}
+
+//Step from one match to the next, running any interrupt that comes up at the
+//tick it comes up
+void HostSimulator::advance(uint64_t ticks) {
+  while(ticks>0) {
+    uint64_t step=ticks;
+    for(int i=0;i<nTimers;i++) {
+      uint64_t d=timer[i].ticksToMatch();
+      if(d<step) step=d;
+    }
+    for(int i=0;i<nTimers;i++) timer[i].run(step);
+    clock+=step;
+    ticks-=step;
+    dispatch();
+  }
+}
+
+void HostSimulator::setCpsr(uint32_t v) {
+  cpsr=v;
+  //An interrupt that came up while masked goes off as soon as it is unmasked
+  dispatch();
+}
+
+void HostSimulator::dispatch() {
+  if(inIrq || (cpsr & I_Bit)) return;
+  for(;;) {
+    uint32_t raw=0;
+    for(int i=0;i<nTimers;i++) if(timer[i].IR & 0x0F) raw|=1<<(TIMER0+i);
+    uint32_t pending=raw & intEnable;
+    if(pending==0) return;
+    fvoid h=nullptr;
+    for(int i=0;i<VIC_SIZE;i++) {
+      if((vectCntl[i] & 0x20) && (pending & (1<<(vectCntl[i] & 0x1F)))) {
+        h=vectAddr[i];
+        break;
+      }
+    }
+    if(!h) {
+      unhandled++;
+      intEnable&=~pending;
+      return;
+    }
+    //Same as the IRQ exception: mask IRQs, run the handler, then unmask
+    inIrq=true;
+    cpsr|=I_Bit;
+    interrupts++;
+    h();
+    cpsr&=~I_Bit;
+    inIrq=false;
+  }
+}
+
+bool HostSimulator::install(unsigned int source, fvoid h) {
+  intEnable&=~(1<<source);
+  for(int i=0;i<VIC_SIZE;i++) {
+    if(vectAddr[i]==nullptr) {
+      vectAddr[i]=h;
+      vectCntl[i]=0x20 | source;
+      intEnable|=1<<source;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool HostSimulator::uninstall(unsigned int source) {
+  intEnable&=~(1<<source);
+  for(int i=0;i<VIC_SIZE;i++) {
+    if((vectCntl[i] & 0x20) && (vectCntl[i] & 0x1F)==source) {
+      vectAddr[i]=nullptr;
+      vectCntl[i]=0;
+      return true;
+    }
+  }
+  return false;
+}
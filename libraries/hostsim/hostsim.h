@@ -0,0 +1,109 @@
+#ifndef hostsim_h
+#define hostsim_h
+
+#include <inttypes.h>
+
+/* Host simulation of the LPC214x timers and VIC, so that the schedulers and
+anything else timing-critical can run on Linux under a virtual clock.
+
+The directory this is in holds stand-ins for the hardware headers (LPC214x.h,
+irq.h, vic.h, scb.h, pinconnect.h, gpio.h, and Time.h) with the same macros
+and classes, backed by this simulator instead of memory-mapped registers. Put
+this directory first on the include path, define HOST_SIM, and the library
+sources compile unchanged for the host. It must never be on the include path
+of a firmware build. A program Makefile which includes
+../libraries/hostsim/Makefile can make schedSim.exe, which runs
+DirectTaskManager and the deferred work queue this way.
+
+Time only passes when something says so:
+  hostSim.advance(ticks) moves the clock, as if the main loop had spent that
+    many PCLK ticks. Interrupts which come due along the way are run at the
+    exact tick they come due, unless IRQs are masked or one is already running.
+  hostSim.spend(ticks) is the same thing, and reads better inside a task or a
+    handler to model the time it takes to run.
+  hostSim.readCost, if nonzero, is spent on every read of a timer counter, so
+    that code which busy-waits on the timer (like KwanTimer::delay) finishes.
+
+The timers step from one match to the next rather than one tick at a time, so
+simulating a minute of a 60MHz timer costs about as much as the matches in it.
+A match sets its interrupt flag, resets the counter on the next tick, or stops
+the timer, as selected in MCR. Prescale is modeled. Capture and external match
+outputs are not.
+
+The VIC dispatches to the lowest numbered enabled slot for a pending source,
+and does not nest. A pending source with no slot is counted in unhandled and
+disabled, where the real default handler would hang.
+*/
+
+typedef void (*fvoid)(void);
+
+class HostSimulator;
+
+/** One simulated timer register. Reads and writes go through this so that
+each register can act like the hardware: IR is write one to clear, TCR
+bit 1 holds the counter in reset, and TC costs readCost to read. */
+class SimReg {
+private:
+  HostSimulator& sim;
+  int port;
+  uint32_t offset;
+public:
+  SimReg(HostSimulator& Lsim, int Lport, uint32_t Loffset):sim(Lsim),port(Lport),offset(Loffset) {};
+  operator uint32_t() const;
+  SimReg& operator=(uint32_t v);
+  SimReg& operator=(const SimReg& v) {return *this=(uint32_t)v;};
+  SimReg& operator|=(uint32_t v) {return *this=(uint32_t)*this | v;};
+  SimReg& operator&=(uint32_t v) {return *this=(uint32_t)*this & v;};
+};
+
+class HostSimulator {
+public:
+  static const int nTimers=2;
+  static const int VIC_SIZE=16;
+  static const uint32_t I_Bit=0x80;
+  static const uint32_t F_Bit=0x40;
+  struct Timer {
+    uint32_t IR,TCR,TC,PR,PC,MCR,MR[4],CCR,CR[4],EMR,CTCR;
+    bool resetPending; ///< TC matched a register with reset on match, so the next tick goes to 0
+    bool running() const {return (TCR & 3)==1;};
+    uint64_t ticksToMatch() const;
+    void run(uint64_t ticks);
+  };
+  Timer timer[nTimers];
+  //VIC
+  uint32_t intEnable;
+  fvoid vectAddr[VIC_SIZE];
+  uint32_t vectCntl[VIC_SIZE];
+  //CPU
+  uint32_t cpsr;       ///< Only the I and F bits mean anything
+  bool inIrq;
+  uint64_t clock;      ///< PCLK ticks since the simulation started
+  uint32_t readCost;   ///< Ticks spent on each read of a timer counter
+  uint32_t interrupts; ///< Handlers run
+  uint32_t unhandled;  ///< Sources which came up with no handler installed
+  uint32_t regReads;   ///< Timer register reads, to count what a scheduler costs
+  uint32_t regWrites;  ///< Timer register writes
+  //Registers of the other stand-ins, which only need to hold a value
+  uint32_t fioDir,fioPin,pinsel[2];
+
+  SimReg timerReg(int port, uint32_t offset) {return SimReg(*this,port,offset);};
+  uint32_t read(int port, uint32_t offset);
+  void write(int port, uint32_t offset, uint32_t v);
+  void advance(uint64_t ticks);
+  void spend(uint64_t ticks) {advance(ticks);};
+  uint64_t now() const {return clock;};
+  void setCpsr(uint32_t v);
+  void dispatch();
+  bool install(unsigned int source, fvoid h);
+  bool uninstall(unsigned int source);
+  /** Put everything back the way it is at reset, including the clock */
+  void reset();
+  HostSimulator() {reset();};
+};
+
+inline HostSimulator hostSim;
+
+inline SimReg::operator uint32_t() const {return sim.read(port,offset);}
+inline SimReg& SimReg::operator=(uint32_t v) {sim.write(port,offset,v);return *this;}
+
+#endif
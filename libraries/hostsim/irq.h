@@ -0,0 +1,50 @@
+#ifndef irq_h
+#define irq_h
+
+/* Host stand-in for irq.h, see hostsim.h. The I and F bits live in the
+simulator, and clearing the I bit lets any interrupt which came up while
+it was set go off right then, as it would on the ARM. */
+
+#include <cinttypes>
+#include "hostsim.h"
+
+inline void set_cpsr_c(const uint32_t val) {
+  hostSim.setCpsr(val);
+}
+
+inline uint32_t get_cpsr_c() {
+  return hostSim.cpsr;
+}
+
+static const uint32_t I_Bit=0x80;    // when I bit is set, IRQ is disabled 
+static const uint32_t F_Bit=0x40;    // when F bit is set, FIQ is disabled 
+
+inline void enable_irq() {
+  set_cpsr_c(get_cpsr_c() & ~I_Bit);
+}
+inline void enable_fiq() {
+  set_cpsr_c(get_cpsr_c() & ~F_Bit);
+};
+inline void disable_irq() {
+  set_cpsr_c(get_cpsr_c() | I_Bit);
+};
+inline void disable_fiq(){
+  set_cpsr_c(get_cpsr_c() | F_Bit);
+};
+inline void enable_ints() {;
+  set_cpsr_c(get_cpsr_c() & ~(I_Bit|F_Bit));
+}
+inline void disable_ints() {
+  set_cpsr_c(get_cpsr_c() | (I_Bit|F_Bit));
+}
+
+inline uint32_t irq_save() {
+  uint32_t cpsr=get_cpsr_c();
+  set_cpsr_c(cpsr | I_Bit);
+  return cpsr;
+}
+inline void irq_restore(uint32_t cpsr) {
+  set_cpsr_c(cpsr);
+}
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef packet_h
+#define packet_h
+
+//Host stand-in for the packet library. The filesystem only names Packet in
+//declarations of telemetry fills that the host tools never call.
+class Packet;
+
+#endif
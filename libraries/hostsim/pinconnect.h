@@ -0,0 +1,22 @@
+#ifndef pinconnect_h
+#define pinconnect_h
+
+/* Host stand-in for pinconnect.h, see hostsim.h */
+
+#include <cinttypes>
+#include <cstddef>
+#include "hostsim.h"
+
+class PinConnectDriver {
+public:
+  void set_pin(int pin, int mode) {
+    int mask=~(0x3 << ((pin & 0x0F)<<1));
+    int val=mode << ((pin & 0x0F)<<1);
+    uint32_t& pinsel=hostSim.pinsel[pin>=16?1:0];
+    pinsel=(pinsel & mask) | val;
+  }
+};
+
+inline PinConnectDriver PinConnect;
+
+#endif
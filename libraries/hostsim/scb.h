@@ -0,0 +1,27 @@
+#ifndef scb_h
+#define scb_h
+
+/* Host stand-in for scb.h, see hostsim.h. The clocks are whatever the real
+one would measure with the default crystal and PLL settings. */
+
+#include <cinttypes>
+#include <cstddef>
+#include "gpio.h"
+
+#ifndef FOSC
+#define FOSC 12'000'000
+#endif
+
+#ifndef PLL_MULTIPLIER
+#define PLL_MULTIPLIER 5
+#endif
+
+class SystemControlBlock {
+public:
+  uint32_t PCLK() {return FOSC*PLL_MULTIPLIER;}
+  uint32_t CCLK() {return FOSC*PLL_MULTIPLIER;}
+  size_t pll_lock_count() {return 0;}
+};
+
+inline SystemControlBlock SCB;
+#endif
@@ -0,0 +1,337 @@
+/* Host simulation of DirectTaskManager, TaskManager, and the deferred work
+queue, running the real library sources against the simulated timer and VIC in
+hostsim.h.
+
+Usage: schedSim [-T] [-n chains] [-t sec] [-p ms,ms,ms] [-w ticks] [-d] [-l ticks] [-s sec] [-m ticks] [-r ticks]
+
+  -T  Run the tasks with the heap TaskManager, all on match channel 1, each
+      scheduled once with schedulePeriodic(), rather than with
+      DirectTaskManager on a channel of their own. This also runs:
+        - chains of one-shot tasks, each of which schedules the next in its
+          chain a pseudo-random 1 tick to 20ms (or a quarter of the timer
+          period, if that is less) from when it runs, and checks that it
+          didn't run early
+        - a 1ms periodic task which is cancelled halfway through the run,
+          and must never run again
+        - a check that the queue takes exactly TASKMANAGER_SIZE tasks
+  -n  Number of one-shot chains with -T, default 8, at most TASKMANAGER_SIZE-4
+
+  -t  Simulated seconds to run, default 120 so that timer 0 wraps at least once
+  -p  Period of the task on each of match channels 1, 2, and 3, in ms. Leave
+      one out (like -p 3,,10) or give 0 to not use that channel. Default 3,7,10
+  -w  Ticks of PCLK each task spends working, default 6000 (100us)
+  -d  Post the tasks to deferredQueue, rather than running them in the
+      interrupt. The main loop then runs the queue every -l ticks, default
+      60000 (1ms)
+  -s  Start timer 0 this many seconds before it wraps, rather than at 0
+  -m  Match 0 of timer 0, default one minute of PCLK less one. Make this small
+      to wrap often.
+  -r  Ticks spent on each read of a timer counter, default 0
+
+Each task reschedules itself one period after it was due, the way the sensor
+tasks do, or is put back on its period by TaskManager, so that it should fire
+exactly on the period forever. Each firing is
+checked against when it was due, counted from when the task was first
+scheduled, in simulated time which doesn't wrap. A task which fires early, or a
+whole period late (which means it missed a match and won't fire again until the
+timer comes around), is an error.
+
+Before that, KwanTimer::delay() is checked against the simulated clock, with
+delays that cross the wrap of timer 1 and that end exactly on it.
+
+The TaskManager run also reports the timer register reads and writes and the
+host time per task run, as a measure of what scheduling costs.
+
+Exit status is 0 if every task fired on time, 2 if any didn't, and 1 on errors.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+#include "hostsim.h"
+//Before LPC214x.h, whose register macros have the same names as Timer32's accessors
+#include "timer.h"
+#include "LPC214x.h"
+#include "Time.h"
+#include "irq.h"
+#include "DirectTask.h"
+#include "Task.h"
+#include "Deferred.h"
+
+struct Channel {
+  unsigned int ch;
+  uint32_t periodMs;
+  uint64_t period;  ///< Period in ticks
+  uint64_t t0;      ///< Simulated time the task was first scheduled
+  uint32_t fired;
+  uint32_t early;
+  uint32_t missed;
+  uint64_t maxLate;
+  uint64_t sumLate;
+};
+
+static Channel chan[4];
+static uint32_t work=6000;
+static bool deferred=false;
+
+//Check one firing of a periodic task against when it was due
+static void fired(Channel& c) {
+  uint64_t now=hostSim.now();
+  c.fired++;
+  uint64_t due=c.t0+c.fired*c.period;
+  if(now<due) {
+    c.early++;
+  } else {
+    uint64_t late=now-due;
+    if(late>=c.period) c.missed++;
+    if(late>c.maxLate) c.maxLate=late;
+    c.sumLate+=late;
+  }
+}
+
+static void task(void* stuff) {
+  Channel& c=*(Channel*)stuff;
+  fired(c);
+  directTaskManager.reschedule(c.ch,c.periodMs,0,task,stuff);
+  hostSim.spend(work);
+}
+
+//TaskManager puts this back in the queue itself
+static void periodicTask(void* stuff) {
+  fired(*(Channel*)stuff);
+  hostSim.spend(work);
+}
+
+struct OneShot {
+  uint64_t due;     ///< Simulated time this is next due
+  uint32_t rand;    ///< State of this chain's random delays
+  uint32_t fired;
+  uint32_t early;
+  uint32_t errors;  ///< schedule() refused the next one
+  uint64_t maxLate;
+  uint64_t sumLate;
+};
+
+//Room for the three periodic tasks and the one to cancel
+static const uint32_t maxChains=TASKMANAGER_SIZE-4;
+static OneShot chain[maxChains];
+static uint32_t maxDelay;  ///< Longest one-shot delay, 20ms or a quarter of the timer period
+
+static void scheduleOneShot(OneShot& o);
+
+static void oneShotTask(void* stuff) {
+  OneShot& o=*(OneShot*)stuff;
+  uint64_t now=hostSim.now();
+  o.fired++;
+  if(now<o.due) {
+    o.early++;
+  } else {
+    uint64_t late=now-o.due;
+    if(late>o.maxLate) o.maxLate=late;
+    o.sumLate+=late;
+  }
+  scheduleOneShot(o);
+  hostSim.spend(work);
+}
+
+static void scheduleOneShot(OneShot& o) {
+  o.rand=o.rand*1664525+1013904223;
+  uint32_t ticks=1+(o.rand>>8)%maxDelay;
+  //schedule() counts from its read of the timer, which comes after the read cost
+  uint64_t before=hostSim.now();
+  if(taskManager.schedule(ticks,oneShotTask,&o)<0) {
+    o.errors++;
+    return;
+  }
+  o.due=before+hostSim.readCost+ticks;
+}
+
+static uint32_t victimFired,victimAfterCancel;
+static bool cancelled=false;
+static void victimTask(void*) {
+  victimFired++;
+  if(cancelled) victimAfterCancel++;
+}
+
+static void fillerTask(void*) {}
+
+//Delay of ms starting start ticks into timer 1, which must take at least ms and
+//at most a few timer reads more
+static bool checkDelay(uint32_t start, uint32_t ms) {
+  TTC(1)=start;
+  uint64_t t=hostSim.now();
+  delay(ms);
+  uint64_t took=hostSim.now()-t;
+  uint64_t want=(uint64_t)ms*(Time::PCLK/1000);
+  bool ok=(took>=want && took<=want+3*hostSim.readCost);
+  if(!ok) printf("delay(%u) from %u took %" PRIu64 " ticks, should be %" PRIu64 "\n",ms,start,took,want);
+  return ok;
+}
+
+static bool checkDelays() {
+  uint32_t interval=TMR0(1)+1;
+  uint32_t oldCost=hostSim.readCost;
+  hostSim.readCost=60;
+  bool ok=true;
+  ok&=checkDelay(0,1);
+  ok&=checkDelay(12345,7);
+  ok&=checkDelay(interval-Time::PCLK/10,250);                   //Across the wrap
+  ok&=checkDelay(interval-Time::PCLK/4-hostSim.readCost,250);  //Ends right on the wrap, after the first read
+  hostSim.readCost=oldCost;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  uint32_t seconds=120;
+  uint32_t loopTicks=60000;
+  uint32_t mr0=Time::PCLK*Time::timerSec-1;
+  double startBefore=-1;
+  uint32_t readCost=0;
+  const char* periods="3,7,10";
+  bool heap=false;
+  uint32_t chains=8;
+  int opt;
+  while((opt=getopt(argc,argv,"Tn:t:p:w:dl:s:m:r:"))!=-1) {
+    switch(opt) {
+      case 'T': heap=true;break;
+      case 'n': chains=strtoul(optarg,nullptr,0);break;
+      case 't': seconds=atoi(optarg);break;
+      case 'p': periods=optarg;break;
+      case 'w': work=strtoul(optarg,nullptr,0);break;
+      case 'd': deferred=true;break;
+      case 'l': loopTicks=strtoul(optarg,nullptr,0);break;
+      case 's': startBefore=atof(optarg);break;
+      case 'm': mr0=strtoul(optarg,nullptr,0);break;
+      case 'r': readCost=strtoul(optarg,nullptr,0);break;
+      default:  argc=0;break;
+    }
+  }
+  //TaskManager always runs its tasks in the interrupt
+  if(argc==0 || optind!=argc || loopTicks==0 || (heap && deferred) || chains>maxChains) {
+    fprintf(stderr,"Usage: %s [-T] [-n chains] [-t sec] [-p ms,ms,ms] [-w ticks] [-d] [-l ticks] [-s sec] [-m ticks] [-r ticks]\n",argv[0]);
+    return 1;
+  }
+  const char* p=periods;
+  for(unsigned int i=1;i<4;i++) {
+    chan[i].ch=i;
+    chan[i].periodMs=strtoul(p,nullptr,0);
+    chan[i].period=(uint64_t)chan[i].periodMs*(Time::PCLK/1000);
+    p=strchr(p,',');
+    if(!p) break;
+    p++;
+  }
+
+  //Timer 1 was set up by KwanTimer when the program started
+  if(!checkDelays()) {
+    printf("KwanTimer::delay() failed\n");
+    return 2;
+  }
+
+  setupTimer0();
+  TMR0(0)=mr0;
+  if(startBefore>=0) TTC(0)=mr0-(uint32_t)(startBefore*Time::PCLK);
+  hostSim.readCost=readCost;
+  //Only one of them may have the timer interrupt
+  if(heap) {
+    taskManager.begin();
+  } else {
+    directTaskManager.begin();
+  }
+  for(unsigned int i=1;i<4;i++) {
+    if(chan[i].periodMs==0) continue;
+    chan[i].t0=hostSim.now();
+    int result;
+    if(heap) {
+      result=taskManager.schedulePeriodic(chan[i].periodMs,0,periodicTask,&chan[i]);
+    } else {
+      if(deferred) directTaskManager.defer(i,0);
+      result=directTaskManager.schedule(i,chan[i].periodMs,0,task,&chan[i]);
+    }
+    if(result<0) {
+      printf("Couldn't schedule the task on channel %u, error %d\n",i,result);
+      return 2;
+    }
+  }
+  bool ok=true;
+  if(heap) {
+    uint32_t period=TMR0(0)+1;
+    maxDelay=20*(Time::PCLK/1000);
+    if(maxDelay>period/4) maxDelay=period/4;
+    for(uint32_t i=0;i<chains;i++) {
+      chain[i].rand=i;
+      scheduleOneShot(chain[i]);
+    }
+    if(taskManager.schedulePeriodic(1,0,victimTask,nullptr)<0) {
+      printf("Couldn't schedule the 1ms task\n");
+      return 2;
+    }
+    //Fill the queue with tasks far in the future, then take them back out
+    int room=TASKMANAGER_SIZE-taskManager.size();
+    int filled=0;
+    while(taskManager.schedule(period/2,fillerTask,nullptr)==0) filled++;
+    int removed=taskManager.cancel(fillerTask,nullptr);
+    if(filled!=room || removed!=room) {
+      printf("Queue had room for %d, took %d fillers and gave back %d\n",room,filled,removed);
+      ok=false;
+    }
+    taskManager.resetMaxLate();
+  }
+
+  clock_t wall0=clock();
+  uint64_t start=hostSim.now();
+  uint64_t end=start+(uint64_t)seconds*Time::PCLK;
+  uint32_t reads0=hostSim.regReads,writes0=hostSim.regWrites;
+  while(hostSim.now()<end) {
+    if(heap && !cancelled && hostSim.now()>=start+(end-start)/2) {
+      uint32_t cpsr=irq_save();
+      int removed=taskManager.cancel(victimTask,nullptr);
+      cancelled=true;
+      irq_restore(cpsr);
+      if(removed!=1) {
+        printf("cancel() removed %d copies of the 1ms task\n",removed);
+        ok=false;
+      }
+    }
+    if(deferred) deferredQueue.runAll();
+    uint64_t left=end-hostSim.now();
+    hostSim.advance(left<loopTicks?left:loopTicks);
+  }
+  double wall=(double)(clock()-wall0)/CLOCKS_PER_SEC;
+
+  if(hostSim.unhandled>0) ok=false;
+  uint32_t tasksRun=0;
+  printf("ch period(ms)   fired expected early missed maxLate(ticks) meanLate(ticks)\n");
+  for(unsigned int i=1;i<4;i++) {
+    Channel& c=chan[i];
+    if(c.periodMs==0) continue;
+    uint32_t expected=(end-c.t0)/c.period;
+    //The last one may be waiting its turn when the run ends
+    if(c.early>0 || c.missed>0 || c.fired+1<expected || c.fired>expected) ok=false;
+    printf("%2u %10u %7u %8u %5u %6u %14" PRIu64 " %15.1f\n",i,c.periodMs,c.fired,expected,c.early,c.missed,c.maxLate,c.fired?(double)c.sumLate/c.fired:0.0);
+    tasksRun+=c.fired;
+  }
+  if(heap) {
+    printf("chain   fired early errors maxLate(ticks) meanLate(ticks)\n");
+    for(uint32_t i=0;i<chains;i++) {
+      OneShot& o=chain[i];
+      if(o.early>0 || o.errors>0 || o.fired==0) ok=false;
+      printf("%5u %7u %5u %6u %14" PRIu64 " %15.1f\n",i,o.fired,o.early,o.errors,o.maxLate,o.fired?(double)o.sumLate/o.fired:0.0);
+      tasksRun+=o.fired;
+    }
+    if(victimAfterCancel>0) ok=false;
+    printf("1ms task ran %u times, %u after it was cancelled\n",victimFired,victimAfterCancel);
+    tasksRun+=victimFired;
+    printf("TaskManager: maxLate %u ticks, %.1f timer register reads and %.1f writes per task run, %.0f ns host time per task run\n",
+           taskManager.getMaxLate(),(double)(hostSim.regReads-reads0)/tasksRun,(double)(hostSim.regWrites-writes0)/tasksRun,wall*1e9/tasksRun);
+  }
+  if(deferred) {
+    printf("deferredQueue: maxWait %u ticks, maxRun %u ticks, maxDepth %u, coalesced %u, overflow %u\n",
+           deferredQueue.getMaxWait(0),deferredQueue.getMaxRun(0),deferredQueue.getMaxDepth(0),
+           deferredQueue.getCoalesced(0),deferredQueue.getOverflow(0));
+  }
+  printf("%u interrupts (%u unhandled) in %.1f simulated s, %.3f s wall, %.0f interrupts/s\n",
+         hostSim.interrupts,hostSim.unhandled,(double)(end-start)/Time::PCLK,wall,wall>0?hostSim.interrupts/wall:0.0);
+  return ok?0:2;
+}
@@ -0,0 +1,85 @@
+#ifndef SDHC_H
+#define SDHC_H
+
+/* Host stand-in for the SD card driver, backed by a disk image file. Same
+interface as the real SDHC that Partition and BlockCache use, but each block
+is a pread() or pwrite() of the image. Counts the block transfers and commands
+the real driver would put on the SPI bus, so a benchmark can see how hard the
+filesystem works the card. */
+
+#include <inttypes.h>
+#include <unistd.h>
+#include <string.h>
+#include "Print.h"
+
+#define FAIL(x) {errno=(x);return false;}
+
+#define ASSERT(x,y) {bool result=(x);if(!result) FAIL((y));return result;}
+
+inline uint32_t tr(uint8_t system, uint8_t function, uint8_t call) {
+  return ((uint32_t)system)<<16 | ((uint32_t)function)<<8 | ((uint32_t)call);
+}
+
+class SDHC {
+private:
+  int fd;
+  bool streaming;
+  uint32_t streamBlock;
+  bool xfer(bool wr, uint32_t offset, char* buffer) {
+    off_t pos=(off_t)offset*BLOCK_SIZE;
+    ssize_t n=wr?pwrite(fd,buffer,BLOCK_SIZE,pos):pread(fd,buffer,BLOCK_SIZE,pos);
+    if(n!=BLOCK_SIZE) FAIL(wr?7:5);
+    return true;
+  }
+public:
+  static const int BLOCK_SIZE=512;
+  unsigned int errno;
+  uint32_t blockReads;  ///< Blocks clocked in from the card, single or streamed
+  uint32_t blockWrites; ///< Blocks clocked out to the card
+  uint32_t commands;    ///< Commands sent, one per single block and one per stream start or stop
+  SDHC(int Lfd):fd(Lfd),streaming(false),streamBlock(0),errno(0) {resetStats();};
+  void resetStats() {blockReads=0;blockWrites=0;commands=0;};
+  bool begin(void) {return fd>=0;};
+  bool read(uint32_t offset, char* buffer) {
+    if(streaming) FAIL(1);
+    commands++;blockReads++;
+    return xfer(false,offset,buffer);
+  };
+  bool read(uint32_t offset, char* buffer, int start, int len) {
+    char block[BLOCK_SIZE];
+    if(start+len>BLOCK_SIZE) FAIL(2);
+    if(!read(offset,block)) return false;
+    memcpy(buffer,block+start,len);
+    return true;
+  };
+  bool write(uint32_t offset, const char* buffer, uint32_t trace) {
+    if(streaming) FAIL(3);
+    commands++;blockWrites++;
+    return xfer(true,offset,const_cast<char*>(buffer));
+  };
+  bool busy() {return false;};
+  bool readStart(uint32_t offset) {
+    if(streaming) FAIL(4);
+    commands++;
+    streaming=true;
+    streamBlock=offset;
+    return true;
+  };
+  bool readNext(char* buffer) {
+    if(!streaming) FAIL(6);
+    blockReads++;
+    if(xfer(false,streamBlock++,buffer)) return true;
+    //The real card sends an error token, and readNext() stops the transfer
+    commands++;
+    streaming=false;
+    return false;
+  };
+  bool readStop() {
+    if(!streaming) FAIL(8);
+    commands++;
+    streaming=false;
+    return true;
+  };
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef VIC_H 
+#define VIC_H
+
+/* Host stand-in for vic.h, see hostsim.h. Same interface, with the vector
+slots in the simulator, which runs the handlers itself in place of IRQ_Wrapper. */
+
+#include "irq.h"
+
+class VICDriver {
+public:  
+  VICDriver() {
+    enable_ints();
+  }
+  bool install(unsigned int IntNumber, fvoid HandlerAddr) {
+    return hostSim.install(IntNumber,HandlerAddr);
+  }
+  bool uninstall(unsigned int IntNumber) {
+    return hostSim.uninstall(IntNumber);
+  }
+  static const int WDT		= 0; ///< Watchdog timer
+  static const int ARM_CORE0	= 2; ///< ARMCore0, used by EmbeddedICE RX
+  static const int ARM_CORE1	= 3; ///< ARMCore1, Used by EmbeddedICE TX
+  static const int TIMER0	= 4; ///< Timer 0 match or capture 
+  static const int TIMER1	= 5; ///< Timer 1 match or capture
+  static const int UART0	= 6; ///< UART 0 interrupt
+  static const int UART1	= 7; ///< UART 1 interrupt
+  static const int I2C0		= 9; ///< I2C 0 interrupt
+  static const int SPI0		=10; ///< SPI 0 interrupt
+  static const int SPI1		=11; ///< SPI 1 interrupt
+  static const int PLL		=12; ///< Phase lock loop in lock
+  static const int RTC		=13; ///< Real-time clock increment or alarm
+  static const int EINT0	=14; ///< External interrupt 0
+  static const int EINT1	=15; ///< External interrupt 1
+  static const int EINT2	=16; ///< External interrupt 2
+  static const int ADC0		=18; ///< Analog-to-Digital Converter 0 end of conversion
+  static const int I2C1		=19; ///< I2C 1 interrupt
+};
+
+inline VICDriver VIC;
+
+#endif
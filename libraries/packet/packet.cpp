@@ -1,3 +1,4 @@
+#include <string.h>
 #include "packet.h"
 #include "Time.h"
 #include "gpio.h"
@@ -30,6 +31,7 @@ bool CCSDS::writeDoc(uint8_t type, const char* desc) {
   Debug.println(doc_apid,16,3);
   if(!fillu16(doc_apid)) {
     Debug.print("Something went wrong printing apid");
+    finish(apid_doc);
     return false;
   }
   //uint16_t position in the packet of the field being described, zero if the whole packet is being named
@@ -37,6 +39,7 @@ bool CCSDS::writeDoc(uint8_t type, const char* desc) {
   Debug.println(type==0?0:stashlen,16,3);
   if(!fillu16(type==0?0:stashlen))  {
     Debug.print("Something went wrong printing position");
+    finish(apid_doc);
     return false;
   }
   //uint8_t type of the field
@@ -44,6 +47,7 @@ bool CCSDS::writeDoc(uint8_t type, const char* desc) {
   Debug.println(type,16,2);
   if(!fill(type)) {
     Debug.print("Something went wrong printing type");
+    finish(apid_doc);
     return false;
   }
   //string field description
@@ -52,6 +56,7 @@ bool CCSDS::writeDoc(uint8_t type, const char* desc) {
   Debug.println("\"");
   if(!fill(desc)) {
     Debug.print("Something went wrong printing description");
+    finish(apid_doc);
     return false;
   }
   return finish(apid_doc);
@@ -63,6 +68,11 @@ bool CCSDS::start(uint16_t apid, uint32_t TC) {
   Debug.print(",tc=0x");
   Debug.print((unsigned int)TC,16,8);
   Debug.println(")");
+  if(apid>=nApids) {
+    Debug.print("Apid is past the end of the seq and docd tables: 0x");
+    Debug.println(apid,HEX);
+    blinklock(apid);
+  }
   if(apid==apid_doc) {
     stash_apid=lock_apid;
     lock_apid=apid;
@@ -94,7 +104,7 @@ bool CCSDS::start(uint16_t apid, uint32_t TC) {
   Debug.print(apid,16,3);
   Debug.print(", so word is 0x");
   Debug.println(word,16,4);
-  if(!fillu16(word)) return false;
+  if(!fillu16(word)) return abandon(apid);
   unsigned short seq_=0;
   if(seq) seq_=seq[apid];
         //data       len        lowbit
@@ -106,16 +116,16 @@ bool CCSDS::start(uint16_t apid, uint32_t TC) {
   Debug.print(seq_,16,4);
   Debug.print(", so word is 0x");
   Debug.println(word,16,4);
-  if(!fillu16(word)) return false;
+  if(!fillu16(word)) return abandon(apid);
   word=0xDEAD;
   Debug.print("Reserving space for length: 0x");
   Debug.println(word,16,4);
-  if(!fillu16(word)) return false; //Reserve space in the packet for length
+  if(!fillu16(word)) return abandon(apid); //Reserve space in the packet for length
   if(Sec) {
     //Secondary header: count of microseconds since beginning of minute
     Debug.print("Sending secondary header: TC=0x");
     Debug.println((unsigned int)TC,16,8);
-    if(!fillu32(TC)) return false;
+    if(!fillu32(TC)) return abandon(apid);
   }
   if(seq) seq[apid]=(seq[apid]+1)& 0x3FFF;
   return true;
@@ -140,6 +150,7 @@ bool CCSDS::finish(uint16_t tag) {
     //so we get another crack at it later.
     if(!buf.isFull()) {
       Debug.print("Copy packet from stash buffer to real buffer");
+      offer(tag,stashbuf,stashlen,stashbuf,0);
       buf.fill(stashbuf,stashlen);
       buf.mark();
       buf.drain();
@@ -158,10 +169,7 @@ bool CCSDS::finish(uint16_t tag) {
   //If we get here, either we are not documenting a packet, or we are writing
   //a doc packet, so write to the real circular buffer.
   //If the buffer is already full, we know not to do this
-  if(buf.isFull()) {
-    lock_apid=0; //otherwise the lock will never be released
-    return false;
-  }
+  if(buf.isFull()) return abandon(tag); //otherwise the lock will never be released
   int len=buf.unreadylen()-7;
   if(len<0) {
     Debug.print("Bad packet finish: 0x");Debug.println(tag,HEX);
@@ -169,6 +177,12 @@ bool CCSDS::finish(uint16_t tag) {
   }
   buf.pokeMid(4,(len >> 8) & 0xFF);
   buf.pokeMid(5,(len >> 0) & 0xFF);
+  if(nSinks>0) {
+    const char *a,*b;
+    uint32_t alen,blen;
+    buf.unreadySpans(a,alen,b,blen);
+    offer(tag,a,alen,b,blen);
+  }
   buf.mark();
   buf.drain();
   if(tag==apid_doc) {
@@ -216,6 +230,14 @@ bool CCSDS::fill(char c) {
   return true;
 }
 
+//Same decision as fill(char), made once for the whole span
+bool CCSDS::fill(const char* in, uint32_t length) {
+  if((lock_apid==apid_doc)||docd[lock_apid]) return buf.fill(in,length);
+  memcpy(stashbuf+stashlen,in,length);
+  stashlen+=length;
+  return true;
+}
+
 //Fill in Big-endian order as specified by CCSDS 102.0-B-5, 1.6a
 bool CCSDS::fillu16(uint16_t in) {
   Debug.print("CCSDS::fillu16(in=");
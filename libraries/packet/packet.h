@@ -1,6 +1,7 @@
 #ifndef packet_h
 #define packet_h
 #include <inttypes.h>
+#include <string.h>
 #include "Circular.h"
 #include "float.h"
 #include "Serial.h"
@@ -99,9 +100,9 @@ public:
   bool filli32(uint32_t in) {return fillu32((uint32_t)in);};///< Write a 32-bit signed integer to the packet. Default implementation casts the value to an unsigned int and writes that.
   bool filli64(uint64_t in) {return fillu64((uint64_t)in);};///< Write a 32-bit signed integer to the packet. Default implementation casts the value to an unsigned int and writes that.
   //Might need to override these for packets where data needs escape sequences. 
-  //Leave non-virtual for now.
+  //The buffer version is virtual so that a packet can copy a whole span at once.
   bool fill(const char*    value);                  ///< Write a null-terminated string.            Note that this does nothing to record the length itself -- you may need to write the length separately.
-  bool fill(const char*    value, uint32_t length); ///< Write a binary buffer of arbitrary length. Note that this does nothing to record the length itself -- you may need to write the length separately.
+  virtual bool fill(const char* value, uint32_t length); ///< Write a binary buffer of arbitrary length. Note that this does nothing to record the length itself -- you may need to write the length separately.
   //These use the rest of the interface to document each field as needed
   bool fill(      char     value /**<[in] value to write*/,               const char* fieldName /**< [in] Field name. Should be a valid identifier*/) {if(!writeDoc(t_u8    ,fieldName))return false;return fill   (value    );}; ///<Write and document an 8-bit value
   bool filli16( int16_t    value /**<[in] value to write*/,               const char* fieldName /**< [in] Field name. Should be a valid identifier*/) {if(!writeDoc(t_i16   ,fieldName))return false;return filli16(value    );}; ///<Write and document a signed 16-bit value
@@ -114,6 +115,8 @@ public:
   bool fill   (const char* value /**<[in] value to write*/, uint32_t len /**<[in] length of buffer to write*/, const char* fieldName /**< [in] Field name. Should be a valid identifier*/) {if(!writeDoc(t_binary,fieldName))return false;return fill   (value,len);}; ///<Write and document a binary buffer of arbitrary length.
   bool fill   (const char* value /**<[in] value to write*/,                                                    const char* fieldName /**< [in] Field name. Should be a valid identifier*/) {if(!writeDoc(t_string,fieldName))return false;return fill   (value    );}; ///<Write and document a null-terminated string.
   void write(unsigned char in) override {fill(in);};
+  void write(const char* in, size_t size) override {fill(in,size);};
+  using Print::write;
   using Print::print;
 };
 
@@ -121,11 +124,7 @@ inline bool Packet::fill(const char* in) {
   Debug.print("Packet::fill(in=\"");
   Debug.print(in);
   Debug.println("\")");
-  while(*in) {
-    if(!fill(*in)) return false;
-    in++;
-  } 
-  return true;
+  return fill(in,strlen(in));
 };
 
 inline bool Packet::fill(const char* in, uint32_t length) {
@@ -140,14 +139,38 @@ inline bool Packet::fill(const char* in, uint32_t length) {
   return true;
 };
 
+/** Something which wants to see every finished packet as well as the main
+buffer, for instance a radio downlink. The sink is shown the packet where it
+already sits, and only copies it if it wants it, so packets that no sink
+selects are never copied a second time. */
+class PacketSink {
+public:
+  /** Called once for each finished packet, before it is marked ready in the main buffer.
+  The packet is a followed by b, where b is empty unless the packet wraps around
+  the end of the main buffer. The pointers are only good during this call. */
+  virtual void offer(uint16_t apid, const char* a, uint32_t alen, const char* b, uint32_t blen)=0;
+};
+
+#ifndef PACKET_MAX_SINKS
+#define PACKET_MAX_SINKS 2
+#endif
+
 class CCSDS: public Packet{
 private:
+  PacketSink* sink[PACKET_MAX_SINKS];
+  int nSinks;
+  void offer(uint16_t apid, const char* a, uint32_t alen, const char* b, uint32_t blen) {for(int i=0;i<nSinks;i++) sink[i]->offer(apid,a,alen,b,blen);};
   uint16_t *seq;
   uint16_t lock_apid;
   bool *docd;
   char* stashbuf;
   int stashlen;
   int stash_apid;
+  uint16_t nApids;
+  /** Drop a packet which couldn't be written, giving the lock back to whoever
+  had it before, so the next start() doesn't think this one is still going
+  \return false, so a failed write can return this directly */
+  bool abandon(uint16_t apid) {lock_apid=(apid==apid_doc)?stash_apid:0;return false;};
   bool writeDoc(uint8_t type, const char* fieldName) override;
   bool writeDoc(              const char*   pktName) override {return writeDoc(0,pktName);};
 public:
@@ -160,15 +183,21 @@ public:
   using Packet::fillu64;
   using Packet::fill;
   using Packet::start;
-  CCSDS(Circular &Lbuf, uint16_t* Lseq=nullptr, bool *Ldocd=nullptr, char* Lstashbuf=nullptr):Packet(Lbuf),seq(Lseq),lock_apid(0),docd(Ldocd),stashbuf(Lstashbuf),stashlen(0),stash_apid(0) {};
+  /** \param LnApids Number of entries in Lseq and Ldocd, which are indexed by apid.
+  Only as many as the highest apid used plus one are needed. */
+  CCSDS(Circular &Lbuf, uint16_t* Lseq=nullptr, bool *Ldocd=nullptr, char* Lstashbuf=nullptr, uint16_t LnApids=2048):Packet(Lbuf),nSinks(0),seq(Lseq),lock_apid(0),docd(Ldocd),stashbuf(Lstashbuf),stashlen(0),stash_apid(0),nApids(LnApids) {};
   bool start(uint16_t apid, uint32_t TC=0xFFFFFFFF) override;
   bool finish(uint16_t tag) override;
   bool fill(char in) override;
+  bool fill(const char* in, uint32_t length) override;
   bool fillu16(uint16_t in) override;
   bool fillu32(uint32_t in) override;
   bool fillu64(uint64_t in) override;
   bool fillfp (fp f) override;
   bool metaDoc() override;
+  /** Add a sink to be offered each finished packet
+  \return true if the sink was added, false if there are already PACKET_MAX_SINKS sinks */
+  bool addSink(PacketSink& Lsink) {if(nSinks>=PACKET_MAX_SINKS) return false;sink[nSinks++]=&Lsink;return true;};
 };
 
 #endif
@@ -0,0 +1,69 @@
+#ifndef packetScan_h
+#define packetScan_h
+
+/* Host side finding of packets in a raw byte stream, shared by the tools which
+read logs and downlink captures. The stream may start in the middle of a
+packet, and may have sync marks, garbage, or lost bytes in it, so a header is
+only believed if it looks like one of ours (version 0, telemetry, not grouped,
+reasonable length) and the header right after its packet does too.
+*/
+
+#include <inttypes.h>
+
+static const int maxPacket=1024;
+
+//Total length of a packet starting at p, or 0 if p doesn't look like the start of a packet
+static inline int packetLen(const uint8_t* p) {
+  int ver =(p[0]>>5) & 0x07;
+  int type=(p[0]>>4) & 0x01;
+  int grp =(p[2]>>6) & 0x03;
+  int len =((p[4]<<8) | p[5])+7;
+  if(ver!=0 || type!=0 || grp!=3) return 0;
+  if(len<7 || len>maxPacket) return 0;
+  return len;
+}
+
+/** Pass each packet believed in buf to packet(p,len)
+\param buf     Bytes of the stream
+\param avail   Number of bytes in buf
+\param eof     True if nothing follows buf. If not, the scan stops at a packet
+               which can't be confirmed until more of the stream arrives.
+\param packet  Called with the start and length of each packet
+\param skipped If not null, the number of bytes which weren't in any believed
+               packet is added to it
+\return Number of bytes used up from the start of buf. The caller keeps the rest
+        and scans it again with more of the stream after it. At eof, this is all
+        of buf.
+*/
+template<typename F>
+static int scanPackets(const uint8_t* buf, int avail, bool eof, F packet, uint64_t* skipped=nullptr) {
+  int pos=0;
+  uint64_t junk=0;
+  while(avail-pos>=6) {
+    int len=packetLen(buf+pos);
+    if(len==0) {
+      pos++;
+      junk++;
+      continue;
+    }
+    //Need the whole packet plus the next header to confirm, unless the stream is over
+    if(avail-pos<len+6 && !eof) break;
+    //A packet which runs past the end of the stream, or is followed by something
+    //which doesn't look like a header, was probably a coincidence
+    if(avail-pos<len || (avail-pos>=len+6 && packetLen(buf+pos+len)==0)) {
+      pos++;
+      junk++;
+      continue;
+    }
+    packet(buf+pos,len);
+    pos+=len;
+  }
+  if(eof) {
+    junk+=avail-pos;
+    pos=avail;
+  }
+  if(skipped) *skipped+=junk;
+  return pos;
+}
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef packetSchema_h
+#define packetSchema_h
+
+#include <inttypes.h>
+#include <string.h>
+
+/* Packet layouts written down once, as a list of macro calls, from which the
+compiler makes everything else: a struct for each packet, the code to fill one,
+a dictionary of every field which is built into the firmware and logged as
+doc packets, and a routine for host decoders to parse one. Since the firmware
+and the decoder are built from the same list, they can't disagree.
+
+A program lists its packets in one macro, which takes the names of the macros
+to call for each part:
+
+#define PACKET_SCHEMA(PKT,FLD,ARR,END) \
+  PKT(0x04,CompassPkt)                \
+    FLD(i16,bx)                       \
+    FLD(i16,by)                       \
+    FLD(i16,bz)                       \
+  END()
+PACKET_SCHEMA_DEFINE(PACKET_SCHEMA)
+
+FLD(type,name) is one field, ARR(type,name,n) is a fixed-length array of
+them, and the types are u8, i16, u16, i32, u32, i64, and u64. Every packet in
+a schema has a secondary header (the timestamp), and like everything else in
+a CCSDS packet, the fields are big-endian.
+
+This makes, for each packet:
+  struct CompassPkt {static const uint16_t apid=0x04;static const uint32_t wireSize=16;int16_t bx,by,bz;};
+  template<class P> bool fill(P& pkt, const CompassPkt& v);          //Fields only, between start and finish
+  bool parse(const uint8_t* p, uint32_t len, CompassPkt& v);         //Whole packet, checks apid and length
+and for the whole schema, packetDict[] and packetDictLen, which
+PacketSchema::writeDict() logs all at once, or writeDictNext() one at a time,
+using the same apid 1 doc packets that Packet::fill(value,"name") writes. This
+header doesn't need any of the firmware, so host decoders can include the
+program's schema as well.
+*/
+
+namespace PacketSchema {
+  typedef uint8_t  u8;
+  typedef int16_t  i16;
+  typedef uint16_t u16;
+  typedef int32_t  i32;
+  typedef uint32_t u32;
+  typedef int64_t  i64;
+  typedef uint64_t u64;
+  //Same codes as Packet::t_*
+  static const uint8_t t_u8 = 1;
+  static const uint8_t t_i16= 2;
+  static const uint8_t t_i32= 3;
+  static const uint8_t t_u16=12;
+  static const uint8_t t_u32=13;
+  static const uint8_t t_i64=14;
+  static const uint8_t t_u64=15;
+  static const uint16_t apid_doc=1;
+  static const uint32_t headerSize=10; ///< Primary header plus timestamp
+
+  /** One line of the dictionary. A packet is an entry with type 0 naming the
+  packet, then one entry for each field (or array of fields) in order. */
+  struct Entry {
+    uint16_t apid;
+    uint8_t type;
+    uint8_t count;
+    const char* name;
+  };
+
+  inline uint32_t typeSize(uint8_t type) {
+    switch(type) {
+      case t_u8:  return 1;
+      case t_i16:
+      case t_u16: return 2;
+      case t_i32:
+      case t_u32: return 4;
+      case t_i64:
+      case t_u64: return 8;
+    }
+    return 0;
+  }
+
+  template<class P> bool put(P& pkt, uint8_t  v) {return pkt.fill((char)v);}
+  template<class P> bool put(P& pkt, int16_t  v) {return pkt.filli16(v);}
+  template<class P> bool put(P& pkt, uint16_t v) {return pkt.fillu16(v);}
+  template<class P> bool put(P& pkt, int32_t  v) {return pkt.filli32(v);}
+  template<class P> bool put(P& pkt, uint32_t v) {return pkt.fillu32(v);}
+  template<class P> bool put(P& pkt, int64_t  v) {return pkt.filli64(v);}
+  template<class P> bool put(P& pkt, uint64_t v) {return pkt.fillu64(v);}
+
+  inline uint64_t getBE(const uint8_t*& q, int n) {
+    uint64_t v=0;
+    for(int i=0;i<n;i++) v=(v<<8) | *q++;
+    return v;
+  }
+  template<class T> void get(const uint8_t*& q, T& v) {v=(T)getBE(q,sizeof(T));}
+
+  //Version 0, telemetry, secondary header, the right apid, and the right length
+  inline bool check(const uint8_t* p, uint32_t len, uint16_t apid, uint32_t wireSize) {
+    if(len!=wireSize) return false;
+    if((p[0] & 0xF8)!=0x08) return false;
+    if((((p[0]<<8) | p[1]) & 0x7FF)!=apid) return false;
+    return (uint32_t)((p[4]<<8) | p[5])==wireSize-7;
+  }
+  inline uint32_t timestamp(const uint8_t* p) {
+    const uint8_t* q=p+6;
+    return (uint32_t)getBE(q,4);
+  }
+
+  //One doc packet: apid described, position of the field in the packet (0 for
+  //the packet name), type, and the name. This is the layout CCSDS::writeDoc uses.
+  template<class P> bool writeDoc(P& pkt, uint16_t apid, uint16_t pos, uint8_t type, const char* name) {
+    if(!pkt.start(apid_doc)) return false;
+    bool ok=pkt.fillu16(apid) && pkt.fillu16(pos) && pkt.fill((char)type) && pkt.fill(name);
+    //Once started, the doc packet holds the packet lock until it is finished
+    return pkt.finish(apid_doc) && ok;
+  }
+
+  /** Where writeDictNext() is up to in a dictionary */
+  struct DictCursor {
+    int i;         ///< Entry to write next
+    int j;         ///< Element of that entry, if it is an array
+    uint16_t apid; ///< Packet the entry belongs to
+    uint16_t pos;  ///< Position of the entry in the packet
+    void reset() {i=0;j=0;apid=0;pos=0;};
+  };
+
+  /** Log the next doc packet of a dictionary. Each element of an array gets its
+  own doc packet, named like imu[3]. The cursor only moves on once the doc
+  packet is written, so one which doesn't fit is tried again next time.
+  
+  \return true if a doc packet was written, false if not, or if the cursor is
+  already at the end (c.i>=n)
+  */
+  template<class P> bool writeDictNext(P& pkt, const Entry* dict, int n, DictCursor& c) {
+    if(c.i>=n) return false;
+    const Entry& e=dict[c.i];
+    if(e.type==0) {
+      if(!writeDoc(pkt,e.apid,0,0,e.name)) return false;
+      c.apid=e.apid;
+      c.pos=headerSize;
+      c.i++;
+      return true;
+    }
+    const char* name=e.name;
+    char elem[32];
+    if(e.count>1) {
+      size_t len=strlen(e.name);
+      if(len>sizeof(elem)-6) len=sizeof(elem)-6;
+      memcpy(elem,e.name,len);
+      elem[len++]='[';
+      if(c.j>=100) elem[len++]='0'+c.j/100;
+      if(c.j>=10)  elem[len++]='0'+(c.j/10)%10;
+      elem[len++]='0'+c.j%10;
+      elem[len++]=']';
+      elem[len]=0;
+      name=elem;
+    }
+    if(!writeDoc(pkt,c.apid,c.pos,e.type,name)) return false;
+    c.pos+=typeSize(e.type);
+    c.j++;
+    if(c.j>=e.count) {
+      c.j=0;
+      c.i++;
+    }
+    return true;
+  }
+
+  /** Log a whole dictionary as doc packets, one per field, so that a log
+  describes itself even to a reader which doesn't have the schema. This puts
+  them all in the buffer at once. To spread them out, call writeDictNext()
+  instead.
+  */
+  template<class P> bool writeDict(P& pkt, const Entry* dict, int n) {
+    DictCursor c;
+    c.reset();
+    while(c.i<n) if(!writeDictNext(pkt,dict,n,c)) return false;
+    return true;
+  }
+}
+
+//Size on the wire, header included
+#define PACKET_SCHEMA_SIZE_PKT(apid_,Name) static const uint32_t Name##_wireSize=PacketSchema::headerSize
+#define PACKET_SCHEMA_SIZE_FLD(type,name) +sizeof(PacketSchema::type)
+#define PACKET_SCHEMA_SIZE_ARR(type,name,n) +(n)*sizeof(PacketSchema::type)
+#define PACKET_SCHEMA_SIZE_END() ;
+//Structs
+#define PACKET_SCHEMA_STRUCT_PKT(apid_,Name) struct Name {static const uint16_t apid=apid_;static const uint32_t wireSize=Name##_wireSize;
+#define PACKET_SCHEMA_STRUCT_FLD(type,name) PacketSchema::type name;
+#define PACKET_SCHEMA_STRUCT_ARR(type,name,n) PacketSchema::type name[n];
+#define PACKET_SCHEMA_STRUCT_END() };
+//Firmware side, fills the fields of a packet which the caller has started
+#define PACKET_SCHEMA_FILL_PKT(apid_,Name) template<class P> bool fill(P& pkt, const Name& v) {
+#define PACKET_SCHEMA_FILL_FLD(type,name) if(!PacketSchema::put(pkt,v.name)) return false;
+#define PACKET_SCHEMA_FILL_ARR(type,name,n) for(int i=0;i<(n);i++) if(!PacketSchema::put(pkt,v.name[i])) return false;
+#define PACKET_SCHEMA_FILL_END() return true;}
+//Host side, parses a whole packet
+#define PACKET_SCHEMA_PARSE_PKT(apid_,Name) inline bool parse(const uint8_t* p, uint32_t len, Name& v) {if(!PacketSchema::check(p,len,Name::apid,Name::wireSize)) return false;const uint8_t* q=p+PacketSchema::headerSize;
+#define PACKET_SCHEMA_PARSE_FLD(type,name) PacketSchema::get(q,v.name);
+#define PACKET_SCHEMA_PARSE_ARR(type,name,n) for(int i=0;i<(n);i++) PacketSchema::get(q,v.name[i]);
+#define PACKET_SCHEMA_PARSE_END() return true;}
+//Dictionary
+#define PACKET_SCHEMA_DICT_PKT(apid_,Name) {apid_,0,1,#Name},
+#define PACKET_SCHEMA_DICT_FLD(type,name) {0,PacketSchema::t_##type,1,#name},
+#define PACKET_SCHEMA_DICT_ARR(type,name,n) {0,PacketSchema::t_##type,n,#name},
+#define PACKET_SCHEMA_DICT_END()
+
+#define PACKET_SCHEMA_DEFINE(schema) \
+  schema(PACKET_SCHEMA_SIZE_PKT,  PACKET_SCHEMA_SIZE_FLD,  PACKET_SCHEMA_SIZE_ARR,  PACKET_SCHEMA_SIZE_END  ) \
+  schema(PACKET_SCHEMA_STRUCT_PKT,PACKET_SCHEMA_STRUCT_FLD,PACKET_SCHEMA_STRUCT_ARR,PACKET_SCHEMA_STRUCT_END) \
+  schema(PACKET_SCHEMA_FILL_PKT,  PACKET_SCHEMA_FILL_FLD,  PACKET_SCHEMA_FILL_ARR,  PACKET_SCHEMA_FILL_END  ) \
+  schema(PACKET_SCHEMA_PARSE_PKT, PACKET_SCHEMA_PARSE_FLD, PACKET_SCHEMA_PARSE_ARR, PACKET_SCHEMA_PARSE_END ) \
+  static const PacketSchema::Entry packetDict[]={ \
+  schema(PACKET_SCHEMA_DICT_PKT,  PACKET_SCHEMA_DICT_FLD,  PACKET_SCHEMA_DICT_ARR,  PACKET_SCHEMA_DICT_END  ) \
+  }; \
+  static const int packetDictLen=sizeof(packetDict)/sizeof(packetDict[0]);
+
+#endif
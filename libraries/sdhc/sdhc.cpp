@@ -24,6 +24,7 @@ bool SDHC::begin() {
   // enable outputs for MOSI, SCK, SS, input for MISO 
   s->claim_cs(p0);
   unselect_card();
+  writing=false;
   // initialize SPI with lowest frequency; max. 400kHz during identification mode of card 
   s->begin(400000,1,1);
 
@@ -200,6 +201,7 @@ bool SDHC::read(uint32_t block, char* buffer, int start, int len) {
   buf.fill32BE((TTC(0) & 0xFFFFFFF0) | 0);
 #endif
   if(start+len>BLOCK_SIZE) FAILREC(8);
+  waitIdle();
 
   // address card 
   select_card();
@@ -232,6 +234,57 @@ bool SDHC::read(uint32_t block, char* buffer, int start, int len) {
   SUCCEED;
 }
 
+bool SDHC::readStart(uint32_t block) {
+#ifdef SDHC_PKT
+  buf.fill32BE(block);
+  buf.fill32BE((TTC(0) & 0xFFFFFFF0) | 2);
+#endif
+  waitIdle();
+  // address card, and leave it addressed until readStop()
+  select_card();
+
+  // send multiple block request 
+  send_command(CMD_READ_MULTIPLE_BLOCK, scale_block_address(block),1);
+  if(response[0]) {
+    unselect_card();
+    FAILREC(100*response[0]+11);
+  }
+  SUCCEED;
+}
+
+//Not recorded in buf, since there may be a great many of these
+bool SDHC::readNext(char* buffer) {
+  // wait for data block (start byte 0xfe). Anything else is an error token,
+  // after which the card is still in the middle of the transfer and must be
+  // sent STOP_TRANSMISSION before it will take another command.
+  unsigned char token;
+  while((token=rec_byte()) == 0xff);
+  if(token!=0xfe) {
+    readStop();
+    FAIL(100*token+12);
+  }
+  s->rx_block(0xFF,buffer,BLOCK_SIZE);
+
+  // read and ignore crc16 
+  rec_byte();
+  rec_byte();
+  return true;
+}
+
+bool SDHC::readStop() {
+  //The response is R1b. There may be a stuff byte before it, and the card holds
+  //the line low while it is busy afterward, so just wait for it to be idle.
+  send_command(CMD_STOP_TRANSMISSION,0,1);
+  while(rec_byte() != 0xff);
+
+  // deaddress card 
+  unselect_card();
+
+  // allow card some time to finish 
+  rec_byte();
+  return true;
+}
+
 bool SDHC::write(uint32_t block, const char* buffer, uint32_t trace) {
 #ifdef SDHC_PKT
   buf.fill32BE(block);
@@ -242,6 +295,7 @@ bool SDHC::write(uint32_t block, const char* buffer, uint32_t trace) {
 //  Serial.print("Block: ");Serial.println((unsigned int)block,HEX,8);
 //  dump.region(buffer,512);
 
+  waitIdle();
   // address card 
   select_card();
 
@@ -262,20 +316,42 @@ bool SDHC::write(uint32_t block, const char* buffer, uint32_t trace) {
   send_byte(0xff);
   send_byte(0xff);
 
-  // wait while card is busy 
-  while(rec_byte() != 0xff);
-  rec_byte();
+  // data response token, xxx00101 if the card accepted the data
+  unsigned char token;
+  while((token=rec_byte()) == 0xff);
+  if((token & 0x1F)!=0x05) {
+    while(rec_byte() != 0xff);
+    unselect_card();
+    FAILREC(100*token+14);
+  }
 
-  // deaddress card 
+  // deaddress card, and let it program the block while we do something else
   unselect_card();
+  rec_byte();
+  writing=true;
 
   SUCCEED;
 }
 
+/** Check whether the card is still programming the last block written. The card
+drives its output low while it is busy, even if it was deselected in the
+meantime, so one byte tells.
+\return true if the card is busy, false if it is ready for another command
+*/
+bool SDHC::busy() {
+  if(!writing) return false;
+  select_card();
+  writing=(rec_byte() != 0xff);
+  unselect_card();
+  if(!writing) rec_byte();
+  return writing;
+}
+
 bool SDHC::get_info(struct SDHC_info& info) {
   if(!available()) FAIL(11);
 
   memset(&info, 0, sizeof(info));
+  waitIdle();
 
   select_card();
 
@@ -145,6 +145,8 @@ static const int CMD_CRC_ON_OFF            = 0x3b;
   void select_card() {s->select_cs(p0);};
   void unselect_card() {s->deselect_cs(p0);};
   uint32_t scale_block_address(uint32_t addr) {return (uint32_t)(card_type & SDHC_SPEC_SDHC ? addr : addr*512);};
+  bool writing; ///< A block was written, and the card may still be programming it
+  void waitIdle() {while(busy());};
 #ifdef SDHC_PKT
   char buf_data[256];
 #endif
@@ -154,13 +156,25 @@ public:
 #endif
   static const int BLOCK_SIZE=512;
   unsigned int errno;
-  SDHC(HardSPI *Ls, int Lp0):spi_user(Ls,Lp0),buf(sizeof(buf_data),buf_data),errno(0) {};
+  SDHC(HardSPI *Ls, int Lp0):spi_user(Ls,Lp0),writing(false),buf(sizeof(buf_data),buf_data),errno(0) {};
   bool begin(void);
   bool available(void);
 
   bool read(uint32_t offset, char* buffer) {return read(offset,buffer,0,BLOCK_SIZE);}; 
   bool read(uint32_t offset, char* buffer, int start, int len);
+  //Returns as soon as the card has taken the block, without waiting for it to
+  //finish programming. Any later command waits for that first, or the caller
+  //may poll busy() and do something else until the card is ready.
   bool write(uint32_t offset, const char* buffer, uint32_t trace);
+  bool busy();
+  //Streaming read of consecutive blocks with one command. While the card
+  //sends one block, it is already fetching the next, and there is no command
+  //overhead per block. Nothing else may use the card between readStart() and
+  //readStop(). If readNext() fails, it has already stopped the transfer, so
+  //don't call readStop() after it.
+  bool readStart(uint32_t offset);
+  bool readNext(char* buffer);
+  bool readStop();
   bool get_info(SDHC_info& info);
 };
 
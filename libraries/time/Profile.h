@@ -0,0 +1,145 @@
+#ifndef profile_h
+#define profile_h
+
+#include <inttypes.h>
+#include "LPC214x.h"
+#include "dtc.h"
+#include "packet.h"
+
+/* Lightweight profiler for named regions of code. Put PROFILE(id) at the top of
+a block, and the time from there to the end of the block is added to the stats
+for that region: count, min, max, total, and a histogram with one bin for each
+power of two ticks. Timing is read straight from the timer counter, so a region
+costs two register reads and a few dozen instructions, cheap enough to leave in
+for flight.
+
+Regions are registered once, normally at startup, with a name:
+
+const int profCollect=profiler.region("collectData");
+...
+void collectData() {
+  PROFILE(profCollect);
+  ...
+}
+
+and write() sends the stats for one region per call as a self-documenting
+packet, then starts that region's stats over, so each packet covers the time
+since the last one for that region.
+
+Stats are not protected against interrupts, so only profile code which runs
+from the main loop. The number of regions may be changed in the program
+Makefile, or profiling taken out entirely, like this:
+
+CDEFS += -DPROFILE_REGIONS=16
+CDEFS += -DPROFILE_DISABLE
+*/
+#ifndef PROFILE_REGIONS
+#define PROFILE_REGIONS 8
+#endif
+
+class Profiler {
+public:
+  static const int bins=24; ///< Last bin also holds everything longer
+private:
+  struct Region {
+    const char* name;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint16_t hist[bins]; ///< hist[i] counts times from 2^i to 2^(i+1)-1 ticks, saturating
+  };
+  Region r[PROFILE_REGIONS];
+  int nRegions;
+  int nextWrite;
+  int timer;
+  void reset(Region& g) {
+    g.count=0;
+    g.min=0xFFFFFFFF;
+    g.max=0;
+    g.sum=0;
+    for(int i=0;i<bins;i++) g.hist[i]=0;
+  };
+  //floor(log2(x)), without a clz instruction on ARM7TDMI
+  static int log2(uint32_t x) {
+    int b=0;
+    if(x>=(1U<<16)) {x>>=16;b+=16;}
+    if(x>=(1U<< 8)) {x>>= 8;b+= 8;}
+    if(x>=(1U<< 4)) {x>>= 4;b+= 4;}
+    if(x>=(1U<< 2)) {x>>= 2;b+= 2;}
+    if(x>=(1U<< 1)) {        b+= 1;}
+    return b;
+  };
+public:
+  Profiler(int Ltimer):nRegions(0),nextWrite(0),timer(Ltimer) {};
+  /** Register a region
+  \return region id to pass to PROFILE() or record(), or -1 if there is no room,
+  in which case the region is silently not profiled */
+  int region(const char* name) {
+    if(nRegions>=PROFILE_REGIONS) return -1;
+    r[nRegions].name=name;
+    reset(r[nRegions]);
+    return nRegions++;
+  };
+  uint32_t now() {return TTC(timer);};
+  /** Ticks since tc0 */
+  uint32_t since(uint32_t tc0) {return dtc(tc0,TTC(timer),timer);};
+  void record(int id, uint32_t ticks) {
+    if(id<0) return;
+    Region& g=r[id];
+    g.count++;
+    g.sum+=ticks;
+    if(ticks<g.min) g.min=ticks;
+    if(ticks>g.max) g.max=ticks;
+    int b=log2(ticks);
+    if(b>=bins) b=bins-1;
+    if(g.hist[b]<0xFFFF) g.hist[b]++;
+  };
+  /** Write the stats for the next region in turn as a packet, then reset them
+  \return true if the packet was written or there are no regions */
+  bool write(Packet& p, uint16_t apid, uint32_t TC) {
+    if(nRegions==0) return true;
+    Region& g=r[nextWrite];
+    nextWrite=(nextWrite+1)%nRegions;
+    char hist[bins*2];
+    for(int i=0;i<bins;i++) {
+      hist[i*2+0]=(g.hist[i]>>8) & 0xFF;
+      hist[i*2+1]=(g.hist[i]>>0) & 0xFF;
+    }
+    if(!p.start(apid,"Profile",TC)) {reset(g);return false;}
+    bool ok=p.fillu32(g.count,"count") &&
+            p.fillu32(g.count>0?g.min:0,"minTicks") &&
+            p.fillu32(g.max,"maxTicks") &&
+            p.fillu64(g.sum,"sumTicks") &&
+            p.fill(hist,sizeof(hist),"log2HistBE16") &&
+            p.fill(g.name,"region");
+    //Finish even if a fill failed, since that is what releases the packet lock
+    ok=p.finish(apid) && ok;
+    reset(g);
+    return ok;
+  };
+};
+
+//Global profiler, timed by Timer0
+inline Profiler profiler(0);
+
+//Time from here to the end of the enclosing block as region id
+class ProfileScope {
+private:
+  Profiler& p;
+  int id;
+  uint32_t tc0;
+public:
+  ProfileScope(Profiler& Lp, int Lid):p(Lp),id(Lid),tc0(Lp.now()) {};
+  ~ProfileScope() {p.record(id,p.since(tc0));};
+};
+
+#ifdef PROFILE_DISABLE
+#define PROFILE(id)
+#else
+#define PROFILE_CAT2(a,b) a##b
+#define PROFILE_CAT(a,b) PROFILE_CAT2(a,b)
+#define PROFILE(id) ProfileScope PROFILE_CAT(profileScope,__LINE__)(profiler,(id))
+#endif
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef dtc_h
+#define dtc_h
+
+#include <inttypes.h>
+#include "LPC214x.h"
+
+/** Ticks from start to end, both read from the counter of the given timer.
+The timer resets to zero on match 0, so it wraps at TMR0+1 rather than at 2^32,
+and end may be less than start. Intervals of a whole wrap or more can't be told
+apart from shorter ones.
+\param start  TTC at the start of the interval
+\param end    TTC at the end of the interval
+\param timer  Timer both counts were read from
+*/
+inline uint32_t dtc(uint32_t start, uint32_t end, int timer=0) {
+  if(end>=start) return end-start;
+  return end+(TMR0(timer)-start)+1;
+}
+
+#endif
@@ -4,6 +4,9 @@
 #include <cinttypes>
 #include "scb.h"
 #include "pinconnect.h"
+#ifdef HOST_SIM
+#include "hostsim.h"
+#endif
 
 template<int port>
 class Timer32 {
@@ -11,18 +14,24 @@ private:
   static const uint32_t TMR0_BASE_ADDR = 0xE000'4000;
   static const uint32_t TMR1_BASE_ADDR = 0xE000'8000;
   static const uint32_t TMR_BASE_DELTA =(TMR1_BASE_ADDR-TMR0_BASE_ADDR);
+#ifdef HOST_SIM
+  //Registers of the simulated timer, see hostsim.h
+  static SimReg reg(uint32_t offset)              {return hostSim.timerReg(port,offset);}
+#else
+  static volatile uint32_t& reg(uint32_t offset)  {return (*(volatile uint32_t*)(TMR0_BASE_ADDR+(port)*TMR_BASE_DELTA + offset));}
+#endif
 protected:
-  static volatile uint32_t& TIR()                 {return (*(volatile uint32_t*)(TMR0_BASE_ADDR+(port)*TMR_BASE_DELTA + 0x00));}
-  static volatile uint32_t& TTCR()                {return (*(volatile uint32_t*)(TMR0_BASE_ADDR+(port)*TMR_BASE_DELTA + 0x04));}
-  static volatile uint32_t& TTC()                 {return (*(volatile uint32_t*)(TMR0_BASE_ADDR+(port)*TMR_BASE_DELTA + 0x08));}
-  static volatile uint32_t& TPR()                 {return (*(volatile uint32_t*)(TMR0_BASE_ADDR+(port)*TMR_BASE_DELTA + 0x0C));}
-  static volatile uint32_t& TPC()                 {return (*(volatile uint32_t*)(TMR0_BASE_ADDR+(port)*TMR_BASE_DELTA + 0x10));}
-  static volatile uint32_t& TMCR()                {return (*(volatile uint32_t*)(TMR0_BASE_ADDR+(port)*TMR_BASE_DELTA + 0x14));}
-  static volatile uint32_t& TMR(uint32_t channel) {return (*(volatile uint32_t*)(TMR0_BASE_ADDR+(port)*TMR_BASE_DELTA + 0x18+(channel)*4));}
-  static volatile uint32_t& TCCR()                {return (*(volatile uint32_t*)(TMR0_BASE_ADDR+(port)*TMR_BASE_DELTA + 0x28));}
-  static volatile uint32_t& TCR(uint32_t channel) {return (*(volatile uint32_t*)(TMR0_BASE_ADDR+(port)*TMR_BASE_DELTA + 0x2C+(channel)*4));}
-  static volatile uint32_t& TEMR()                {return (*(volatile uint32_t*)(TMR0_BASE_ADDR+(port)*TMR_BASE_DELTA + 0x3C));}
-  static volatile uint32_t& TCTCR()               {return (*(volatile uint32_t*)(TMR0_BASE_ADDR+(port)*TMR_BASE_DELTA + 0x70));}
+  static decltype(auto) TIR()                     {return reg(0x00);}
+  static decltype(auto) TTCR()                    {return reg(0x04);}
+  static decltype(auto) TTC()                     {return reg(0x08);}
+  static decltype(auto) TPR()                     {return reg(0x0C);}
+  static decltype(auto) TPC()                     {return reg(0x10);}
+  static decltype(auto) TMCR()                    {return reg(0x14);}
+  static decltype(auto) TMR(uint32_t channel)     {return reg(0x18+(channel)*4);}
+  static decltype(auto) TCCR()                    {return reg(0x28);}
+  static decltype(auto) TCR(uint32_t channel)     {return reg(0x2C+(channel)*4);}
+  static decltype(auto) TEMR()                    {return reg(0x3C);}
+  static decltype(auto) TCTCR()                   {return reg(0x70);}
   static const constexpr uint8_t pin_map_p[8]={2,4,6,255,10,11,17,18};
   static const uint8_t pin_mode_timer=2;
   static const uint8_t pin_mode_gpio=0;
@@ -107,7 +116,7 @@ public:
     }
     if(ms==0) return;
     unsigned int TC1=TC0+ms*(SCB.PCLK()/1000);
-    if(TC1>timerInterval) {
+    if(TC1>=timerInterval) {
       //Do this while we are waiting
       TC1-=timerInterval;
       //wait for the top of the timer reset cycle